@@ -1,14 +1,54 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
 
 class GateKeeper;
+class Register;
+class TickOutputOnly;
+class Input;
+class Cell;
+class WordOp;
 
 /** A gate is a one-output zero-input simple gate. There are exactly three types: Nand, LowOutput and Register, and I/O.
- * The idea is that every digital circuit can be created using these elements... So I had to try */
+ * The idea is that every digital circuit can be created using these elements... So I had to try. The cells and
+ * flip-flops came later, as natively simulated shortcuts for the common circuits made of them */
 class IGate {
+    friend class GateKeeper;
+protected:
+    /** the GateKeeper owning this gate, and the gate's index in it */
+    GateKeeper* keeper = nullptr;
+    int id = -1;
 public:
     virtual void tick1() {};
     virtual void tick2() {};
@@ -18,6 +58,7 @@ public:
     virtual IGate* getInput(int i) const=0;
     virtual ~IGate() {}
     virtual std::string getType() const=0;
+    int getId() const { return id; }
 };
 
 /** builds a long name used by mostly in prototype to generate names to the gates */
@@ -37,17 +78,421 @@ public:
     const std::string& getName() const { return name; }
 };
 
-/** stores all the gates in a circuit, manages its' lifetimes */
+/** A barrier for a fixed number of threads, which spins instead of sleeping, as the waits between the levels of a tick
+ * are much shorter than a wake-up. It yields after a while, so it does not starve the others if there are more threads
+ * than cores. */
+class SpinBarrier {
+    const int threads;
+    std::atomic<int> arrived{0};
+    std::atomic<uint64_t> generation{0};
+public:
+    explicit SpinBarrier(int threads) : threads(threads) {}
+    static void spinUntil(const std::function<bool()>& done) {
+        for (int spins = 0; !done(); spins++)
+            if (spins > 1024) std::this_thread::yield();
+    }
+    void wait() {
+        uint64_t gen = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == threads) {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        spinUntil([&] { return generation.load(std::memory_order_acquire) != gen; });
+    }
+};
+
+/** A persistent pool of spinning threads. run() executes a job on every thread, the caller being thread 0, and returns
+ * when all of them finished. The workers spin between the jobs, so back to back ticks do not pay for a wake-up, but park
+ * on a condition variable once no job came for parkAfter, so an idle pool does not burn the cores. */
+class SpinningPool {
+    static constexpr std::chrono::microseconds parkAfter{1000};
+
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<int> running{0};
+    std::atomic<int> parked{0};
+    std::atomic<bool> stopping{false};
+    const std::function<void(int)>* job = nullptr;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+
+    void waitForJob(uint64_t seen) {
+        auto arrived = [&] { return generation.load(std::memory_order_acquire) != seen; };
+        auto start = std::chrono::steady_clock::now();
+        for (int spins = 0; !arrived(); spins++) {
+            if (spins < 1024) continue;
+            if (std::chrono::steady_clock::now() - start < parkAfter) {
+                std::this_thread::yield();
+                continue;
+            }
+            // counted as parked before checking the generation again, so release() either sees it parked or this
+            // sees the new generation
+            std::unique_lock<std::mutex> lock(mutex);
+            parked.fetch_add(1);
+            wakeUp.wait(lock, arrived);
+            parked.fetch_sub(1);
+        }
+    }
+    /** starts the next generation, waking the parked workers */
+    void release() {
+        generation.fetch_add(1);
+        if (parked.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeUp.notify_all();
+        }
+    }
+public:
+    explicit SpinningPool(int threads) {
+        for (int i = 1; i < threads; i++)
+            workers.emplace_back([this, i] {
+                uint64_t seen = 0;
+                for (;;) {
+                    waitForJob(seen);
+                    seen = generation.load(std::memory_order_acquire);
+                    if (stopping) return;
+                    (*job)(i);
+                    running.fetch_sub(1, std::memory_order_release);
+                }
+            });
+    }
+    ~SpinningPool() {
+        stopping = true;
+        release();
+        for (auto& t : workers) t.join();
+    }
+    int getNumThreads() const { return (int)workers.size() + 1; }
+    void run(const std::function<void(int)>& f) {
+        job = &f;
+        running.store((int)workers.size(), std::memory_order_relaxed);
+        release();
+        f(0);
+        SpinBarrier::spinUntil([&] { return running.load(std::memory_order_acquire) == 0; });
+    }
+};
+
+/** stores all the gates in a circuit, manages its' lifetimes, and ticks them with one of the engines.
+ * Every engine but Lazy levelizes the nands on the first tick after linking, and can optimize them, see
+ * setOptimizations(). */
 class GateKeeper {
+public:
+    enum class Engine {
+        /** every net is computed exactly once per tick into a value array, in topological level order */
+        Levelized,
+        /** the nands are evaluated when read, and remember their value until the next tick or input change */
+        Lazy,
+        /** the values are kept between ticks, and only the fan-out of the changed registers and inputs is evaluated */
+        EventDriven,
+        /** every net carries 64, 256 or 512 lanes, one stimulus vector each, given by Input::setLanes(). The gates'
+         * own values are not maintained, read the lanes instead. */
+        BitParallel,
+        /** the levels of at least minLevelWidth nands are split between the threads of a pool, the others are computed
+         * by the ticking thread */
+        LevelParallel,
+        /** the input cones of the registers and probes are split between threads, each duplicating the nands it needs,
+         * so the threads only meet once per tick */
+        Partitioned,
+        /** the fanout-free cones are tasks, released as their inputs are done, and stolen by idle workers */
+        WorkStealing,
+    };
+    /** passes over the levelized nands, which do not change what the registers and the probes see */
+    enum Optimization : unsigned {
+        /** nands reading a low, or two constant highs, are constant, and are computed once instead of every tick. A
+         * nand reading one constant high becomes a not of its other input. */
+        FoldConstants = 1,
+        /** nands reading the same two nets, in either order, are merged, and a not of a not is replaced by the net it
+         * inverts twice. The merged nands read the value of the one they were merged into. */
+        HashNands = 2,
+        /** only the logic the probes and the observed gates depend on is simulated, through any number of registers.
+         * The other nands and registers are left out of the ticks, so their values are not kept up to date. */
+        RemoveDeadLogic = 4,
+    };
+    /** the most 64-bit lane words a net can have with the BitParallel engine */
+    static constexpr int MaxLaneWords = 8;
+private:
+    struct NandStep { int out, in1, in2; };
+    struct CellStep { size_t before; int out; const Cell* cell; const WordOp* word; int firstInput, numInputs; };
+    using NandKernel = void (*)(uint64_t* lanes, const NandStep* begin, const NandStep* end);
+
     std::vector<std::pair<std::string, std::unique_ptr<IGate>>> gates;
+    const Engine engine;
+    uint64_t epoch = 1;
+    bool levelized = false;
+    bool valuesComputed = false;
+    std::vector<char> values;
+    std::vector<int> sources; // non-nand gates read by others, their values are fetched at the start of every tick
+    std::vector<NandStep> nands; // in level order, so every input is computed before it is read
+    std::vector<IGate*> sequential; // gates having tick phases, in the order of addition
+    std::vector<CellStep> cellSteps; // in level order, each computed before the nand it is placed at
+    std::vector<int> cellInputs; // the inputs of cell step c are cellInputs[firstInput..firstInput+numInputs)
+    std::vector<uint64_t> words; // by gate id, the values of the bus nets, whose lowest bit is in values
+    std::vector<char> isWordNet; // by gate id
+    std::vector<int> wordSources; // the sources which are bus nets
+    std::vector<uint64_t> wordOperands; // the inputs of the word step being computed
+    unsigned optimizations = 0;
+    std::vector<char> folded; // by gate id, constant nands taken out of nands, their values are set once
+    std::vector<int> representative; // by gate id, the net computing the gate's value, itself unless merged
+    std::map<std::string, int> hashedByPrototype;
+    std::vector<const IGate*> observed;
+
+    // the register file of the Levelized and EventDriven engines
+    std::vector<uint64_t> registerBits, nextRegisterBits; // by slot
+    std::vector<int> registerIds, registerInputs; // by slot
+    std::vector<IGate*> ticking; // the sequential gates, except the registers and the inputs having no tick phases
+
+    // only used by run()
+    bool fastForward = false;
+    size_t maxRecordedBytes = 1 << 26;
+    uint64_t simulatedTicks = 0;
+
+    // only used by the EventDriven engine
+    bool fullSweep = true; // the values are not computed yet
+    std::vector<int> levelOf, nandIndex; // by gate id
+    std::vector<int> fanoutStart, fanout; // the nands reading gate i are fanout[fanoutStart[i]..fanoutStart[i+1])
+    std::vector<std::vector<int>> pending; // scheduled nands by level
+    std::vector<char> scheduled;
+    std::vector<int> changedSources;
+    uint64_t evaluations = 0, ticks = 0;
+
+    // only used by the BitParallel engine
+    const int laneWords;
+    NandKernel nandKernel = nullptr;
+    const char* kernelName = "";
+    std::vector<uint64_t> lanes; // laneWords words by gate id
+    std::vector<uint64_t> nextLanes; // laneWords words by register
+    std::vector<std::pair<int, int>> registers; // the id of the register and its input
+    std::vector<std::pair<TickOutputOnly*, int>> probes;
+    std::vector<Input*> inputs;
+
+    template<int W> static void nandLanes(uint64_t* lanes, const NandStep* begin, const NandStep* end);
+#ifdef HAS_X86_KERNELS
+    template<int W> static void nandLanesAvx2(uint64_t* lanes, const NandStep* begin, const NandStep* end);
+    template<int W> static void nandLanesAvx512(uint64_t* lanes, const NandStep* begin, const NandStep* end);
+#endif
+    // only used by the LevelParallel engine
+    struct Phase { int begin, end; bool parallel; }; // a range of nands
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int minLevelWidth = 256;
+    std::vector<Phase> phases;
+    std::vector<IGate*> registerGates, otherSequential;
+    std::unique_ptr<SpinningPool> pool;
+    std::unique_ptr<SpinBarrier> barrier;
+
+    // only used by the Partitioned engine, which also uses the pool
+    struct Partition {
+        std::vector<std::pair<int, int>> sources; // global id and local index of the non-nand gates read, but folded
+        std::vector<NandStep> steps; // in local indices, in level order
+        std::vector<std::pair<Register*, int>> latches; // with the local index of their input
+        std::vector<std::pair<int, int>> exports; // local index and global id of the nets read by the probes
+        std::vector<char> local;
+    };
+    std::vector<Partition> partitions;
+
+    // only used by the WorkStealing engine, which also uses the pool
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<int> tasks; // the owner takes from the back, the thieves from the front
+    };
+    std::vector<int> taskStart; // the nands of task t are nands[taskStart[t]..taskStart[t+1]), reordered by task
+    std::vector<int> successorStart, successors, dependencies; // by task
+    std::unique_ptr<std::atomic<int>[]> remaining; // unfinished dependencies by task
+    std::unique_ptr<WorkerQueue[]> workerQueues;
+    std::atomic<uint64_t> steals{0};
+
+    void selectKernel();
+    void levelize();
+    void foldConstants();
+    void hashNands();
+    void removeDeadLogic();
+    void placeCells(const std::vector<int>& level);
+    void partition();
+    void buildTasks();
+    void tickWorkStealing();
+    void tickLanes();
+    void tickParallel();
+    void tickPartitioned();
+    /** these engines keep the registers in a bit-packed, double-buffered register file, instead of the Register objects */
+    bool usesRegisterFile() const { return engine == Engine::Levelized || engine == Engine::EventDriven; }
+    void buildRegisterFile();
+    void latchRegisters() {
+        for (size_t w = 0; w < nextRegisterBits.size(); w++) {
+            uint64_t word = 0;
+            size_t end = std::min(registerInputs.size(), w * 64 + 64);
+            for (size_t k = w * 64; k < end; k++) word |= (uint64_t)(values[registerInputs[k]] != 0) << (k & 63);
+            nextRegisterBits[w] = word;
+        }
+    }
+    void commitRegisters() {
+        if (engine == Engine::EventDriven) {
+            for (size_t w = 0; w < registerBits.size(); w++)
+                for (uint64_t diff = registerBits[w] ^ nextRegisterBits[w]; diff; diff &= diff - 1)
+                    changedSources.push_back(registerIds[w * 64 + __builtin_ctzll(diff)]);
+        }
+        registerBits.swap(nextRegisterBits);
+    }
+    void sweep();
+    void schedule(int id) {
+        for (int k = fanoutStart[id]; k < fanoutStart[id + 1]; k++) {
+            int f = fanout[k];
+            if (scheduled[f]) continue;
+            scheduled[f] = true;
+            pending[levelOf[f]].push_back(f);
+        }
+    }
+    void propagate() {
+        if (fullSweep) {
+            sweep();
+            evaluations += nands.size();
+            fullSweep = false;
+            changedSources.clear();
+            return;
+        }
+        for (int i : changedSources) {
+            bool v = gates[i].second->getValue();
+            if (v == (bool)values[i]) continue;
+            values[i] = v;
+            schedule(i);
+        }
+        changedSources.clear();
+        for (auto& level : pending) {
+            for (int i = 0; i < (int)level.size(); i++) { // nands of the same level cannot schedule each other
+                auto& n = nands[nandIndex[level[i]]];
+                scheduled[n.out] = false;
+                evaluations++;
+                bool v = !(values[n.in1] && values[n.in2]);
+                if (v == (bool)values[n.out]) continue;
+                values[n.out] = v;
+                schedule(n.out);
+            }
+            level.clear();
+        }
+    }
 public:
+    /** laneWidth is the number of lanes of the BitParallel engine: 64, 256 or 512 */
+    GateKeeper(Engine engine = Engine::Levelized, int laneWidth = 64) : engine(engine), laneWords(laneWidth / 64) {
+        assert(laneWidth == 64 || laneWidth == 256 || laneWidth == 512);
+    }
+    Engine getEngine() const { return engine; }
+    /** a combination of Optimization flags, applied on the next levelization */
+    void setOptimizations(unsigned flags) {
+        optimizations = flags;
+        levelized = false;
+    }
+    /** keeps the gate's value up to date with RemoveDeadLogic, as if a probe was reading it */
+    void observe(const IGate* gate) {
+        observed.push_back(gate);
+        levelized = false;
+    }
+    /** the number of nands removed by FoldConstants */
+    int getNumFoldedNands() const { return (int)std::count(folded.begin(), folded.end(), true); }
+    /** the number of nands removed by HashNands, by the prototype they were in */
+    const std::map<std::string, int>& getHashedByPrototype() const { return hashedByPrototype; }
+    /** the number of nands simulated in a tick, after the optimizations */
+    int getNumSimulatedNands() const { return (int)nands.size(); }
+    /** the number of threads used by the parallel engines, and the least number of nands in a level
+     * for the LevelParallel engine to use them */
+    void setParallelism(int numThreads, int minWidth) {
+        assert(numThreads >= 1 && minWidth >= 1);
+        threads = numThreads;
+        minLevelWidth = minWidth;
+        levelized = false;
+    }
+    int getLaneWidth() const { return laneWords * 64; }
+    /** the nands computed by the partitions of the Partitioned engine, relative to the nands of the design */
+    double getDuplication() const {
+        size_t total = 0;
+        for (auto& p : partitions) total += p.steps.size();
+        return nands.empty() ? 1.0 : (double)total / nands.size();
+    }
+    /** the number of cones of the WorkStealing engine, and the tasks taken from another worker so far */
+    int getNumTasks() const { return taskStart.empty() ? 0 : (int)taskStart.size() - 1; }
+    uint64_t getSteals() const { return steals; }
+    /** lets run() skip the periods of the register state with the Levelized and EventDriven engines, recording at most
+     * maxBytes of state and probe values to find them; a run whose period does not fit is ticked plainly */
+    void setFastForward(bool enabled, size_t maxBytes = 1 << 26) {
+        fastForward = enabled;
+        maxRecordedBytes = maxBytes;
+    }
+    /** the ticks run() computed, the others were replayed from a recorded cycle */
+    uint64_t getSimulatedTicks() const { return simulatedTicks; }
+    /** ticks the given times, the inputs should not change meanwhile */
+    void run(uint64_t numTicks);
+    /** the name of the kernel computing the nands of the BitParallel engine, known after the first tick */
+    const char* getKernelName() const { return kernelName; }
     void addGate(LongNameBuilder name, std::unique_ptr<IGate> gate) {
+        gate->keeper = this;
+        gate->id = (int)gates.size();
+        levelized = false;
         gates.push_back({name.getName(), std::move(gate)});
     }
+    /** true while the values of the current tick are computed, and can be used instead of evaluating the gates */
+    bool hasComputedValues() const { return valuesComputed; }
+    bool getComputedValue(int id) const { return values[representative[id]]; }
+    uint64_t getComputedWord(int id) const { return words[id]; }
+    bool getRegisterBit(int slot) const { return registerBits[slot >> 6] >> (slot & 63) & 1; }
+    /** values memoized in an earlier epoch are stale */
+    uint64_t getEpoch() const { return epoch; }
+    void invalidate() { epoch++; }
+    /** called by the non-combinational gates when their value changes */
+    void changed(int id) {
+        if (engine == Engine::EventDriven && levelized) changedSources.push_back(id);
+    }
+    /** the ratio of the nand evaluations done by the EventDriven engine to the ones a Levelized engine would do */
+    double getActivityFactor() const {
+        return ticks && !nands.empty() ? (double)evaluations / ((double)nands.size() * ticks) : 0.0;
+    }
+    /** a word of the lanes of a net in the last tick of the BitParallel engine */
+    uint64_t getLanes(const IGate* gate, int word = 0) const {
+        return lanes[representative[gate->id] * laneWords + word];
+    }
+    /** finds an input by its name, or returns nullptr */
+    Input* findInput(const std::string& name) const;
     void tick() {
-        for (auto& c: gates) c.second->tick1();
-        for (auto& c: gates) c.second->tick2();
+        if (!levelized) levelize();
+        if (engine == Engine::BitParallel) {
+            tickLanes();
+            return;
+        }
+        if (engine == Engine::LevelParallel) {
+            tickParallel();
+            return;
+        }
+        if (engine == Engine::Partitioned) {
+            tickPartitioned();
+            return;
+        }
+        if (engine == Engine::WorkStealing) {
+            tickWorkStealing();
+            return;
+        }
+        if (usesRegisterFile()) {
+            if (engine == Engine::Levelized) {
+                sweep();
+            } else {
+                propagate();
+                ticks++;
+            }
+            valuesComputed = true;
+            latchRegisters();
+            for (auto c : ticking) c->tick1();
+            valuesComputed = false;
+            invalidate();
+            commitRegisters();
+            for (auto c : ticking) c->tick2();
+            return;
+        }
+        for (auto c : sequential) c->tick1();
+        valuesComputed = false;
+        invalidate();
+        for (auto c : sequential) c->tick2();
     }
+    int getNumGates() const { return (int)gates.size(); }
+    const IGate* getGate(int id) const { return gates[id].second.get(); }
+    /** the long name the gate was added with */
+    const std::string& getGateName(int id) const { return gates[id].first; }
+    /** the topological level of every gate by id: 0 for the sequential gates and the low outputs, and one more than the
+     * highest input for the nands and the truth tables */
+    std::vector<int> computeLevels() const;
     void print() const {
         for (auto& i: gates) {
             std::cout << i.first << std::endl;
@@ -61,6 +506,7 @@ class Gate : public IGate {
     std::array<IGate*,N> inputs;
 public:
     static constexpr int InputSize = N;
+    static constexpr int OutputSize = 1;
     IGate*& getInput(int i) override { return inputs.at(i); }
     IGate* getInput(int i) const override { return inputs.at(i); }
     Gate(const Gate&)=delete;
@@ -81,36 +527,416 @@ public:
 
 /** A simple register, or repeater: always returns the last tick's value */
 class Register : public Gate<1> {
+    friend class GateKeeper;
     bool value=false;
     bool nextValue = false;
+    int slot = -1; // in the register file of the keeper, if it has one
 public:
     std::string getType() const override { return "register"; }
     void tick1() override { nextValue = getInput(0)->getValue(); }
-    void tick2() override { value = nextValue; }
+    /** latches a value computed elsewhere instead of tick1() */
+    void latch(bool v) { nextValue = v; }
+    void tick2() override {
+        if (value != nextValue && keeper) keeper->changed(id);
+        value = nextValue;
+    }
     bool getValue() const {
+        if (slot >= 0) return keeper->getRegisterBit(slot);
         return value;
     }
 };
 
 /** A nand gate: Not(And(A,B)) */
 class Nand : public Gate<2> {
+    mutable bool cached = false;
+    mutable uint64_t cachedEpoch = 0;
 public:
     std::string getType() const override { return "nand"; }
     bool getValue() const override {
+        if (keeper && keeper->hasComputedValues()) return keeper->getComputedValue(id);
+        if (keeper && keeper->getEngine() == GateKeeper::Engine::Lazy) {
+            if (cachedEpoch != keeper->getEpoch()) {
+                cached = !(getInput(0)->getValue() && getInput(1)->getValue());
+                cachedEpoch = keeper->getEpoch();
+            }
+            return cached;
+        }
         return !(getInput(0)->getValue() && getInput(1)->getValue());
     }
 };
 
+/** A combinational gate of up to 32 inputs, computing its value from the bits of its inputs, the first input being the
+ * lowest bit. The Levelized engine packs the values of the inputs in its sweep, the Lazy engine evaluates the inputs
+ * recursively like for the nands. A multi-output cell is a gate by output, sharing the inputs */
+class Cell : public IGate {
+    std::vector<IGate*> inputs;
+    mutable bool cached = false;
+    mutable uint64_t cachedEpoch = 0;
+
+    bool evaluate() const {
+        uint32_t combination = 0;
+        for (int i = 0; i < (int)inputs.size(); i++) combination |= (uint32_t)inputs[i]->getValue() << i;
+        return compute(combination);
+    }
+public:
+    explicit Cell(int numInputs) : inputs(numInputs, nullptr) { assert(numInputs <= 32); }
+    static constexpr int OutputSize = 1;
+    virtual bool compute(uint32_t combination) const=0;
+    int getNumInputs() const override { return (int)inputs.size(); }
+    IGate*& getInput(int i) override { return inputs.at(i); }
+    IGate* getInput(int i) const override { return inputs.at(i); }
+    bool getValue() const override {
+        if (keeper && keeper->hasComputedValues()) return keeper->getComputedValue(id);
+        if (keeper && keeper->getEngine() == GateKeeper::Engine::Lazy) {
+            if (cachedEpoch != keeper->getEpoch()) {
+                cached = evaluate();
+                cachedEpoch = keeper->getEpoch();
+            }
+            return cached;
+        }
+        return evaluate();
+    }
+};
+
+/** Native cells, each replacing a few nands by one evaluation. The N-input ones take 1 to 32 inputs */
+template<int N>
+class AndCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    AndCell() : Cell(N) {}
+    std::string getType() const override { return "and"; }
+    bool compute(uint32_t combination) const override { return combination == ~0u >> (32 - N); }
+};
+
+template<int N>
+class OrCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    OrCell() : Cell(N) {}
+    std::string getType() const override { return "or"; }
+    bool compute(uint32_t combination) const override { return combination != 0; }
+};
+
+template<int N>
+class NandCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    NandCell() : Cell(N) {}
+    std::string getType() const override { return "nand"; }
+    bool compute(uint32_t combination) const override { return combination != ~0u >> (32 - N); }
+};
+
+template<int N>
+class NorCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    NorCell() : Cell(N) {}
+    std::string getType() const override { return "nor"; }
+    bool compute(uint32_t combination) const override { return combination == 0; }
+};
+
+/** high if an odd number of inputs are high */
+template<int N>
+class XorCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    XorCell() : Cell(N) {}
+    std::string getType() const override { return "xor"; }
+    bool compute(uint32_t combination) const override { return __builtin_parity(combination); }
+};
+
+template<int N>
+class XnorCell : public Cell {
+public:
+    static constexpr int InputSize = N;
+    XnorCell() : Cell(N) {}
+    std::string getType() const override { return "xnor"; }
+    bool compute(uint32_t combination) const override { return !__builtin_parity(combination); }
+};
+
+class NotCell : public Cell {
+public:
+    static constexpr int InputSize = 1;
+    NotCell() : Cell(1) {}
+    std::string getType() const override { return "not"; }
+    bool compute(uint32_t combination) const override { return !combination; }
+};
+
+/** inputs: select, the value when select is low, the value when select is high */
+class MuxCell : public Cell {
+public:
+    static constexpr int InputSize = 3;
+    MuxCell() : Cell(3) {}
+    std::string getType() const override { return "mux"; }
+    bool compute(uint32_t combination) const override { return combination >> (combination & 1 ? 2 : 1) & 1; }
+};
+
+/** inputs: the two bits and the carry in, outputs: the sum and the carry out */
+class FullAdderCell : public Cell {
+    const int output;
+public:
+    static constexpr int InputSize = 3;
+    static constexpr int OutputSize = 2;
+    explicit FullAdderCell(int output) : Cell(3), output(output) { assert(output == 0 || output == 1); }
+    std::string getType() const override { return output == 0 ? "full adder sum" : "full adder carry"; }
+    bool compute(uint32_t combination) const override {
+        return output == 0 ? __builtin_parity(combination) : __builtin_popcount(combination) >= 2;
+    }
+};
+
+/** A flip-flop keeping its value until its inputs change it on a tick, like a register with a say on its next value */
+class FlipFlop : public Gate<3> {
+    bool value = false;
+    bool nextValue = false;
+protected:
+    virtual bool next(bool value) const=0;
+public:
+    void tick1() override { nextValue = next(value); }
+    void tick2() override {
+        if (value != nextValue && keeper) keeper->changed(id);
+        value = nextValue;
+    }
+    bool getValue() const override { return value; }
+};
+
+/** inputs: data, enable, reset. Takes the data when enabled, reset wins over enable */
+class DFlipFlop : public FlipFlop {
+protected:
+    bool next(bool value) const override {
+        return !getInput(2)->getValue() && (getInput(1)->getValue() ? getInput(0)->getValue() : value);
+    }
+public:
+    std::string getType() const override { return "D flip-flop"; }
+};
+
+/** inputs: set, reset, enable. Only changes when enabled, reset wins over set */
+class SRFlipFlop : public FlipFlop {
+protected:
+    bool next(bool value) const override {
+        if (!getInput(2)->getValue()) return value;
+        return !getInput(1)->getValue() && (getInput(0)->getValue() || value);
+    }
+public:
+    std::string getType() const override { return "SR flip-flop"; }
+};
+
+/** An output of a tabulated combinational prototype: looks its value up in a row of the prototype's truth table instead
+ * of evaluating nands */
+class TruthTable : public Cell {
+    const std::shared_ptr<const std::vector<uint64_t>> row;
+public:
+    TruthTable(int numInputs, std::shared_ptr<const std::vector<uint64_t>> row) : Cell(numInputs), row(std::move(row)) {}
+    std::string getType() const override { return "truth table"; }
+    bool compute(uint32_t combination) const override { return (*row)[combination >> 6] >> (combination & 63) & 1; }
+};
+
+/** A bus net of 1 to 64 bits. Read as a bit, it is its lowest bit; the word primitives read a bit net as 0 or 1 */
+class WordGate : public IGate {
+    const int width;
+public:
+    explicit WordGate(int width) : width(width) { assert(width >= 1 && width <= 64); }
+    int getWidth() const { return width; }
+    uint64_t getMask() const { return width == 64 ? ~0ull : (1ull << width) - 1; }
+    virtual uint64_t getWord() const=0;
+    bool getValue() const override { return getWord() & 1; }
+    static uint64_t wordOf(const IGate* gate) {
+        auto word = dynamic_cast<const WordGate*>(gate);
+        return word ? word->getWord() : gate->getValue();
+    }
+};
+
+/** A combinational word-level primitive, computed once per tick by the Levelized sweep like the cells. The shifts take
+ * the amount from their second input, Mux selects its third input when its first is high, Concat packs its bits
+ * first input lowest, and Bit takes one bit of its input: a split is a Bit by bit */
+class WordOp : public WordGate {
+public:
+    enum Op { Add, Sub, And, Or, Xor, Not, ShiftLeft, ShiftRight, Equal, Less, Mux, Concat, Bit };
+    static int numInputsOf(Op op, int width) {
+        switch (op) {
+            case Not: case Bit: return 1;
+            case Mux: return 3;
+            case Concat: return width;
+            default: return 2;
+        }
+    }
+private:
+    const Op op;
+    const uint64_t operandMask;
+    const int bit;
+    std::vector<IGate*> inputs;
+    mutable uint64_t cached = 0;
+    mutable uint64_t cachedEpoch = 0;
+
+    uint64_t evaluate() const {
+        std::array<uint64_t, 64> operands;
+        for (int i = 0; i < (int)inputs.size(); i++) operands[i] = wordOf(inputs[i]);
+        return compute(operands.data());
+    }
+public:
+    static constexpr int OutputSize = 1;
+    /** width is the width of the operands, or the number of bits of Concat. Equal, Less and Bit are one bit wide */
+    WordOp(Op op, int width, int bit = 0)
+        : WordGate(op == Equal || op == Less || op == Bit ? 1 : width), op(op),
+          operandMask(width == 64 ? ~0ull : (1ull << width) - 1), bit(bit), inputs(numInputsOf(op, width), nullptr) {
+        assert(bit >= 0 && bit < width);
+    }
+    std::string getType() const override {
+        static const char* const names[] = {"add", "sub", "and", "or", "xor", "not", "shift left", "shift right", "equal",
+                                            "less", "mux", "concat", "bit"};
+        return std::string("word ") + names[op];
+    }
+    int getNumInputs() const override { return (int)inputs.size(); }
+    IGate*& getInput(int i) override { return inputs.at(i); }
+    IGate* getInput(int i) const override { return inputs.at(i); }
+    uint64_t compute(const uint64_t* in) const {
+        const uint64_t m = getMask(), om = operandMask;
+        switch (op) {
+            case Add: return (in[0] + in[1]) & m;
+            case Sub: return (in[0] - in[1]) & m;
+            case And: return in[0] & in[1] & m;
+            case Or: return (in[0] | in[1]) & m;
+            case Xor: return (in[0] ^ in[1]) & m;
+            case Not: return ~in[0] & m;
+            case ShiftLeft: return in[1] >= 64 ? 0 : in[0] << in[1] & m;
+            case ShiftRight: return in[1] >= 64 ? 0 : (in[0] & om) >> in[1];
+            case Equal: return (in[0] & om) == (in[1] & om);
+            case Less: return (in[0] & om) < (in[1] & om);
+            case Mux: return (in[0] & 1 ? in[2] : in[1]) & m;
+            case Concat: {
+                uint64_t word = 0;
+                for (int i = 0; i < (int)inputs.size(); i++) word |= (in[i] & 1) << i;
+                return word;
+            }
+            case Bit: return in[0] >> bit & 1;
+        }
+        return 0;
+    }
+    uint64_t getWord() const override {
+        if (keeper && keeper->hasComputedValues()) return keeper->getComputedWord(id);
+        if (keeper && keeper->getEngine() == GateKeeper::Engine::Lazy) {
+            if (cachedEpoch != keeper->getEpoch()) {
+                cached = evaluate();
+                cachedEpoch = keeper->getEpoch();
+            }
+            return cached;
+        }
+        return evaluate();
+    }
+};
+
+/** A register of a bus net */
+class WordRegister : public WordGate {
+    IGate* input = nullptr;
+    uint64_t value = 0;
+    uint64_t nextValue = 0;
+public:
+    static constexpr int OutputSize = 1;
+    explicit WordRegister(int width) : WordGate(width) {}
+    std::string getType() const override { return "word register"; }
+    int getNumInputs() const override { return 1; }
+    IGate*& getInput(int i) override { assert(i == 0); return input; }
+    IGate* getInput(int i) const override { assert(i == 0); return input; }
+    void tick1() override { nextValue = wordOf(input) & getMask(); }
+    void tick2() override {
+        if (value != nextValue && keeper) keeper->changed(id);
+        value = nextValue;
+    }
+    uint64_t getWord() const override { return value; }
+};
+
+/** A synchronous memory of depth words of width bits, stored contiguously in the fewest bytes holding a word. Its inputs
+ * are the address, and for a RAM the data and the write enable. On a tick it reads the word at the address and, if
+ * enabled, writes the data there, the read getting the word from before the write; its value is the last word read.
+ * It can be initialized from a binary file of little-endian words, mapped privately so writes never reach the file */
+class Memory : public WordGate {
+    std::vector<IGate*> inputs;
+    const size_t depth;
+    const int bytesPerWord;
+    uint8_t* storage = nullptr;
+    std::vector<uint8_t> owned; // the storage, unless it is mapped
+    void* mapped = MAP_FAILED;
+    size_t mappedSize = 0;
+    uint64_t value = 0;
+    uint64_t nextValue = 0;
+    bool writing = false;
+    size_t writeAddress = 0;
+    uint64_t writeData = 0;
+public:
+    static constexpr int OutputSize = 1;
+    /** a ROM has only the address input, and its mapped file is shared with the page cache instead of copied */
+    Memory(size_t depth, int width, bool readOnly = false, const std::string& file = "")
+        : WordGate(width), inputs(readOnly ? 1 : 3, nullptr), depth(depth), bytesPerWord((width + 7) / 8) {
+        assert(depth >= 1);
+        size_t bytes = depth * bytesPerWord;
+        if (file.empty()) {
+            owned.assign(bytes, 0);
+            storage = owned.data();
+            return;
+        }
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("could not open " + file);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < bytes) {
+            close(fd);
+            throw std::runtime_error(file + " is smaller than the memory");
+        }
+        mapped = mmap(nullptr, bytes, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("could not map " + file);
+        mappedSize = bytes;
+        storage = (uint8_t*)mapped;
+    }
+    Memory(const Memory&)=delete;
+    Memory& operator=(const Memory&)=delete;
+    ~Memory() {
+        if (mapped != MAP_FAILED) munmap(mapped, mappedSize);
+    }
+    std::string getType() const override { return inputs.size() == 1 ? "rom" : "ram"; }
+    int getNumInputs() const override { return (int)inputs.size(); }
+    IGate*& getInput(int i) override { return inputs.at(i); }
+    IGate* getInput(int i) const override { return inputs.at(i); }
+    size_t getDepth() const { return depth; }
+    uint64_t read(size_t address) const {
+        uint64_t word = 0;
+        std::memcpy(&word, storage + address * bytesPerWord, bytesPerWord);
+        return word & getMask();
+    }
+    /** writes a word directly, to load a RAM without ticking */
+    void write(size_t address, uint64_t word) {
+        assert(inputs.size() == 3 && address < depth);
+        std::memcpy(storage + address * bytesPerWord, &word, bytesPerWord);
+    }
+    void tick1() override {
+        uint64_t address = wordOf(inputs[0]);
+        nextValue = address < depth ? read(address) : 0;
+        writing = inputs.size() == 3 && address < depth && inputs[2]->getValue();
+        if (writing) writeAddress = address, writeData = wordOf(inputs[1]) & getMask();
+    }
+    void tick2() override {
+        if (writing) write(writeAddress, writeData);
+        if (value != nextValue && keeper) keeper->changed(id);
+        value = nextValue;
+    }
+    uint64_t getWord() const override { return value; }
+};
+
 /** shows its value on every tick */
 class TickOutputOnly : public Gate<1> {
-    int t=0;
+    uint64_t t=0;
     const std::string name;
 public:
     TickOutputOnly(std::string name) : Gate(), name(std::move(name)) {}
     std::string getType() const override { return "tick - outputonly"; }
+    const std::string& getName() const { return name; }
 
-    void tick1() override {
-        std::cout << name.c_str() << ": tick" << ++t << ": " << (getInput(0)->getValue() ? 'H' : 'L') << std::endl;
+    void tick1() override { show(getInput(0)->getValue()); }
+    void show(bool value) { std::cout << name.c_str() << ": tick" << ++t << ": " << (value ? 'H' : 'L') << std::endl; }
+    /** shows the lanes of the BitParallel engine as hexadecimal words, the lowest bit of the first word being the first
+     * lane */
+    void showLanes(const uint64_t* in, int words) {
+        std::cout << name.c_str() << ": tick" << ++t << ":" << std::hex << std::setfill('0');
+        for (int w = 0; w < words; w++) std::cout << " 0x" << std::setw(16) << in[w];
+        std::cout << std::dec << std::setfill(' ') << std::endl;
     }
     bool getValue() const override {
         assert(false);
@@ -118,19 +944,1685 @@ public:
     }
 };
 
-/** changeable input */
-class Input : public Gate<2> {
-    // TODO Input gates cannot be found, and, as such, they cannot be changed in a circuit
+/** changeable input, can be found by its name with GateKeeper::findInput */
+class Input : public Gate<0> {
     bool val=false;
+    std::array<uint64_t, GateKeeper::MaxLaneWords> lanes{};
     std::string name;
 public:
     Input(std::string name) : Gate(), name(std::move(name)) { }
     std::string getType() const override { return "user-input"; }
+    const std::string& getName() const { return name; }
     void setValue(bool newVal) {
+        if (keeper && val != newVal) keeper->changed(id);
         val = newVal;
+        lanes.fill(newVal ? ~0ull : 0);
+        if (keeper) keeper->invalidate();
+    }
+    bool getValue() const override {
+        return val;
+    }
+    /** sets a word of the lanes for the BitParallel engine */
+    void setLanes(uint64_t newLanes, int word = 0) {
+        if (word == 0) { // the value is the first lane, the other words are left as they are
+            if (keeper && val != (bool)(newLanes & 1)) keeper->changed(id);
+            val = newLanes & 1;
+            if (keeper) keeper->invalidate();
+        }
+        lanes.at(word) = newLanes;
+    }
+    uint64_t getLanes(int word) const { return lanes[word]; }
+};
+
+Input* GateKeeper::findInput(const std::string& name) const {
+    for (auto& g : gates) {
+        auto input = dynamic_cast<Input*>(g.second.get());
+        if (input && input->getName() == name) return input;
+    }
+    return nullptr;
+}
+
+void GateKeeper::sweep() {
+    for (int i : sources) values[i] = gates[i].second->getValue();
+    for (int i : wordSources) words[i] = static_cast<WordGate*>(gates[i].second.get())->getWord();
+    for (size_t k = 0; k < registerIds.size(); k++) values[registerIds[k]] = getRegisterBit((int)k);
+    size_t k = 0;
+    for (auto& c : cellSteps) {
+        for (; k < c.before; k++) values[nands[k].out] = !(values[nands[k].in1] && values[nands[k].in2]);
+        if (c.word) {
+            for (int j = 0; j < c.numInputs; j++) {
+                int in = cellInputs[c.firstInput + j];
+                wordOperands[j] = isWordNet[in] ? words[in] : values[in];
+            }
+            words[c.out] = c.word->compute(wordOperands.data());
+            values[c.out] = words[c.out] & 1;
+            continue;
+        }
+        uint32_t combination = 0;
+        for (int j = 0; j < c.numInputs; j++) combination |= (uint32_t)values[cellInputs[c.firstInput + j]] << j;
+        values[c.out] = c.cell->compute(combination);
+    }
+    for (; k < nands.size(); k++) values[nands[k].out] = !(values[nands[k].in1] && values[nands[k].in2]);
+}
+
+std::vector<int> GateKeeper::computeLevels() const {
+    int n = (int)gates.size();
+    std::vector<int> level(n, -1); // -1: not visited, -2: being visited
+    for (int i = 0; i < n; i++)
+        if (!dynamic_cast<Nand*>(gates[i].second.get()) && !dynamic_cast<Cell*>(gates[i].second.get())
+            && !dynamic_cast<WordOp*>(gates[i].second.get())) level[i] = 0;
+    // depth first search without recursion, as carry chains can be very deep
+    std::vector<int> stack;
+    for (int i = 0; i < n; i++) {
+        stack.push_back(i);
+        while (!stack.empty()) {
+            int c = stack.back();
+            if (level[c] >= 0) {
+                stack.pop_back();
+                continue;
+            }
+            level[c] = -2;
+            IGate* g = gates[c].second.get();
+            int lvl = 0;
+            bool ready = true;
+            for (int j = 0; j < g->getNumInputs(); j++) {
+                int in = g->getInput(j)->id;
+                assert(level[in] != -2 && "combinational loop");
+                if (level[in] == -1) {
+                    ready = false;
+                    stack.push_back(in);
+                } else {
+                    lvl = std::max(lvl, level[in] + 1);
+                }
+            }
+            if (ready) {
+                level[c] = lvl;
+                stack.pop_back();
+            }
+        }
+    }
+    return level;
+}
+
+/** should be called after linking: collects the gates having tick phases, and for the Levelized and EventDriven engines
+ * sorts the nands by their distance from the non-combinational gates */
+void GateKeeper::levelize() {
+    int n = (int)gates.size();
+    std::vector<char> isRead(n, false);
+    sequential.clear();
+    for (int i = 0; i < n; i++) {
+        IGate* g = gates[i].second.get();
+        for (int j = 0; j < g->getNumInputs(); j++) {
+            assert(g->getInput(j) && "gate is not linked");
+            isRead[g->getInput(j)->id] = true;
+        }
+        if (!dynamic_cast<Nand*>(g) && !dynamic_cast<LowOutput*>(g) && !dynamic_cast<Cell*>(g) && !dynamic_cast<WordOp*>(g))
+            sequential.push_back(g);
+    }
+    if (engine == Engine::Lazy) {
+        levelized = true;
+        return;
+    }
+    std::vector<int> level = computeLevels();
+    int maxLevel = level.empty() ? 0 : *std::max_element(level.begin(), level.end());
+    std::vector<std::vector<NandStep>> buckets(maxLevel + 1);
+    sources.clear();
+    cellSteps.clear();
+    cellInputs.clear();
+    wordSources.clear();
+    isWordNet.assign(n, false);
+    for (int i = 0; i < n; i++) {
+        IGate* g = gates[i].second.get();
+        isWordNet[i] = dynamic_cast<WordGate*>(g) != nullptr;
+        if (level[i] == 0) {
+            if (isRead[i] && !(usesRegisterFile() && dynamic_cast<Register*>(g))) sources.push_back(i);
+            if (isRead[i] && isWordNet[i]) wordSources.push_back(i);
+        } else if (dynamic_cast<Cell*>(g) || dynamic_cast<WordOp*>(g)) {
+            cellSteps.push_back({0, i, dynamic_cast<Cell*>(g), dynamic_cast<WordOp*>(g), (int)cellInputs.size(), g->getNumInputs()});
+            for (int j = 0; j < g->getNumInputs(); j++) cellInputs.push_back(g->getInput(j)->id);
+        } else {
+            buckets[level[i]].push_back({i, g->getInput(0)->id, g->getInput(1)->id});
+        }
+    }
+    if ((!cellSteps.empty() || !wordSources.empty()) && engine != Engine::Levelized)
+        throw std::runtime_error("cells and words need the Levelized or the Lazy engine");
+    nands.clear();
+    for (auto& b : buckets) nands.insert(nands.end(), b.begin(), b.end());
+    values.assign(n, false);
+    words.assign(n, 0);
+    wordOperands.assign(64, 0);
+    folded.assign(n, false);
+    representative.resize(n);
+    for (int i = 0; i < n; i++) representative[i] = i;
+    if (optimizations & FoldConstants) foldConstants();
+    if (optimizations & HashNands) hashNands();
+    if (optimizations & RemoveDeadLogic) removeDeadLogic();
+    placeCells(level);
+    levelized = true;
+    if (usesRegisterFile()) buildRegisterFile();
+    if (engine == Engine::BitParallel) {
+        selectKernel();
+        lanes.assign((size_t)n * laneWords, 0);
+        for (int i = 0; i < n; i++)
+            if (folded[i] && values[i]) std::fill_n(&lanes[(size_t)i * laneWords], laneWords, ~0ull);
+        registers.clear();
+        probes.clear();
+        inputs.clear();
+        for (auto g : sequential) {
+            if (dynamic_cast<Register*>(g)) {
+                registers.push_back({g->id, representative[g->getInput(0)->id]});
+            } else if (auto p = dynamic_cast<TickOutputOnly*>(g)) {
+                probes.push_back({p, representative[g->getInput(0)->id]});
+            } else if (auto in = dynamic_cast<Input*>(g)) {
+                inputs.push_back(in);
+            } else {
+                assert(false && "gate not supported by the BitParallel engine");
+            }
+        }
+        nextLanes.assign(registers.size() * laneWords, 0);
+    }
+    if (engine == Engine::Partitioned) partition();
+    if (engine == Engine::WorkStealing) buildTasks();
+    if (engine == Engine::LevelParallel) {
+        phases.clear();
+        for (int b = 0, e; b < (int)nands.size(); b = e) {
+            for (e = b; e < (int)nands.size() && level[nands[e].out] == level[nands[b].out]; e++) {}
+            bool parallel = threads > 1 && e - b >= minLevelWidth;
+            if (!parallel && !phases.empty() && !phases.back().parallel) phases.back().end = e;
+            else phases.push_back({b, e, parallel});
+        }
+        registerGates.clear();
+        otherSequential.clear();
+        for (auto g : sequential) (dynamic_cast<Register*>(g) ? registerGates : otherSequential).push_back(g);
+        bool wide = threads > 1 && (int)registerGates.size() >= minLevelWidth;
+        for (auto& ph : phases) wide = wide || ph.parallel;
+        if (wide && (!pool || pool->getNumThreads() != threads)) {
+            pool = std::make_unique<SpinningPool>(threads);
+            barrier = std::make_unique<SpinBarrier>(threads);
+        } else if (!wide) {
+            pool.reset();
+            barrier.reset();
+        }
+    }
+    if (engine != Engine::EventDriven) return;
+
+    levelOf = level;
+    nandIndex.assign(n, -1);
+    fanoutStart.assign(n + 1, 0);
+    for (int k = 0; k < (int)nands.size(); k++) {
+        nandIndex[nands[k].out] = k;
+        fanoutStart[nands[k].in1 + 1]++;
+        if (nands[k].in2 != nands[k].in1) fanoutStart[nands[k].in2 + 1]++;
+    }
+    for (int i = 0; i < n; i++) fanoutStart[i + 1] += fanoutStart[i];
+    fanout.assign(fanoutStart[n], 0);
+    std::vector<int> filled(fanoutStart.begin(), fanoutStart.end() - 1);
+    for (auto& nand : nands) {
+        fanout[filled[nand.in1]++] = nand.out;
+        if (nand.in2 != nand.in1) fanout[filled[nand.in2]++] = nand.out;
+    }
+    pending.assign(maxLevel + 1, {});
+    scheduled.assign(n, false);
+    changedSources.clear();
+    fullSweep = true;
+}
+
+template<int W>
+void GateKeeper::nandLanes(uint64_t* lanes, const NandStep* begin, const NandStep* end) {
+    for (auto n = begin; n != end; ++n)
+        for (int w = 0; w < W; w++)
+            lanes[n->out * W + w] = ~(lanes[n->in1 * W + w] & lanes[n->in2 * W + w]);
+}
+
+#ifdef HAS_X86_KERNELS
+template<int W>
+__attribute__((target("avx2")))
+void GateKeeper::nandLanesAvx2(uint64_t* lanes, const NandStep* begin, const NandStep* end) {
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    auto at = [lanes](int id, int k) { return (__m256i*)(lanes + id * W) + k; };
+    for (auto n = begin; n != end; ++n)
+        for (int k = 0; k < W / 4; k++) {
+            __m256i a = _mm256_loadu_si256(at(n->in1, k)), b = _mm256_loadu_si256(at(n->in2, k));
+            _mm256_storeu_si256(at(n->out, k), _mm256_xor_si256(_mm256_and_si256(a, b), ones));
+        }
+}
+
+template<int W>
+__attribute__((target("avx512f")))
+void GateKeeper::nandLanesAvx512(uint64_t* lanes, const NandStep* begin, const NandStep* end) {
+    auto at = [lanes](int id) { return (void*)(lanes + id * W); };
+    for (auto n = begin; n != end; ++n) {
+        __m512i a = _mm512_loadu_si512(at(n->in1)), b = _mm512_loadu_si512(at(n->in2));
+        _mm512_storeu_si512(at(n->out), _mm512_ternarylogic_epi64(a, b, b, 0x3f)); // 0x3f: not (a and b)
+    }
+}
+#endif
+
+/** picks the widest kernel the CPU supports for the lane width, falling back to the portable one */
+void GateKeeper::selectKernel() {
+    if (laneWords == 1) {
+        nandKernel = nandLanes<1>, kernelName = "scalar";
+        return;
+    }
+#ifdef HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (laneWords == 8 && __builtin_cpu_supports("avx512f")) {
+        nandKernel = nandLanesAvx512<8>, kernelName = "avx512";
+        return;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        nandKernel = laneWords == 4 ? nandLanesAvx2<4> : nandLanesAvx2<8>, kernelName = "avx2";
+        return;
+    }
+#endif
+    nandKernel = laneWords == 4 ? nandLanes<4> : nandLanes<8>, kernelName = "scalar";
+}
+
+void GateKeeper::foldConstants() {
+    const signed char unknown = -1;
+    std::vector<signed char> constant(gates.size(), unknown);
+    for (int i = 0; i < (int)gates.size(); i++)
+        if (dynamic_cast<LowOutput*>(gates[i].second.get())) constant[i] = 0;
+    std::vector<NandStep> kept;
+    for (auto n : nands) { // in level order, so the inputs are known before
+        signed char a = constant[n.in1], b = constant[n.in2];
+        if (a == 0 || b == 0 || (a == 1 && b == 1)) {
+            constant[n.out] = !(a == 1 && b == 1);
+            values[n.out] = constant[n.out];
+            folded[n.out] = true;
+            continue;
+        }
+        if (a == 1) n.in1 = n.in2;
+        if (b == 1) n.in2 = n.in1;
+        kept.push_back(n);
+    }
+    nands = std::move(kept);
+}
+
+/** merges the nands in level order, so their inputs are already merged when they are hashed, repeating it until
+ * nothing changes */
+void GateKeeper::hashNands() {
+    auto prototypeOf = [](const std::string& name) { // the type before the gate's own type in the long name
+        size_t own = name.rfind('[');
+        size_t start = own == std::string::npos || own == 0 ? std::string::npos : name.rfind('[', own - 1);
+        return start == std::string::npos ? std::string("") : name.substr(start + 1, name.find(']', start) - start - 1);
+    };
+    hashedByPrototype.clear();
+    std::vector<int> notOf(gates.size(), -1); // by the id of a kept not, the net it inverts
+    for (bool changed = true; changed;) {
+        changed = false;
+        std::unordered_map<uint64_t, int> byInputs;
+        std::fill(notOf.begin(), notOf.end(), -1);
+        std::vector<NandStep> kept;
+        for (auto n : nands) {
+            n.in1 = representative[n.in1], n.in2 = representative[n.in2];
+            if (n.in1 > n.in2) std::swap(n.in1, n.in2);
+            int merged = -1;
+            if (n.in1 == n.in2 && notOf[n.in1] >= 0) {
+                merged = notOf[n.in1];
+            } else {
+                auto it = byInputs.find((uint64_t)n.in1 << 32 | (uint32_t)n.in2);
+                if (it != byInputs.end()) merged = it->second;
+            }
+            if (merged >= 0) {
+                representative[n.out] = merged;
+                hashedByPrototype[prototypeOf(gates[n.out].first)]++;
+                changed = true;
+                continue;
+            }
+            byInputs[(uint64_t)n.in1 << 32 | (uint32_t)n.in2] = n.out;
+            if (n.in1 == n.in2) notOf[n.out] = n.in1;
+            kept.push_back(n);
+        }
+        nands = std::move(kept);
+    }
+    // a merged gate may have been merged into one merged later
+    for (int i = 0; i < (int)representative.size(); i++)
+        while (representative[representative[i]] != representative[i]) representative[i] = representative[representative[i]];
+}
+
+/** marks the nets backward from the probes, the other ticked gates and the observed gates, through the nands, the cells
+ * and the registers, and keeps only the marked nands, cells and registers */
+void GateKeeper::removeDeadLogic() {
+    std::vector<int> stepOf(gates.size(), -1);
+    for (int k = 0; k < (int)nands.size(); k++) stepOf[nands[k].out] = k;
+    std::vector<int> cellOf(gates.size(), -1);
+    for (int k = 0; k < (int)cellSteps.size(); k++) cellOf[cellSteps[k].out] = k;
+    std::vector<char> live(gates.size(), false);
+    std::vector<int> stack;
+    for (auto g : sequential) // the probes, and the flip-flops and word registers, which are always ticked
+        if (!dynamic_cast<Register*>(g))
+            for (int j = 0; j < g->getNumInputs(); j++) stack.push_back(representative[g->getInput(j)->id]);
+    for (auto g : observed) stack.push_back(representative[g->id]);
+    while (!stack.empty()) {
+        int c = stack.back();
+        stack.pop_back();
+        if (live[c]) continue;
+        live[c] = true;
+        if (stepOf[c] >= 0) {
+            stack.push_back(nands[stepOf[c]].in1);
+            stack.push_back(nands[stepOf[c]].in2);
+        } else if (cellOf[c] >= 0) {
+            auto& cell = cellSteps[cellOf[c]];
+            for (int j = 0; j < cell.numInputs; j++) stack.push_back(representative[cellInputs[cell.firstInput + j]]);
+        } else if (dynamic_cast<Register*>(gates[c].second.get())) {
+            stack.push_back(representative[gates[c].second->getInput(0)->id]);
+        }
+    }
+    nands.erase(std::remove_if(nands.begin(), nands.end(), [&live](const NandStep& n) { return !live[n.out]; }), nands.end());
+    cellSteps.erase(std::remove_if(cellSteps.begin(), cellSteps.end(), [&live](const CellStep& c) { return !live[c.out]; }),
+                    cellSteps.end());
+    std::vector<IGate*> kept;
+    for (auto g : sequential) {
+        auto r = dynamic_cast<Register*>(g);
+        if (!r || live[g->id]) {
+            kept.push_back(g);
+            continue;
+        }
+        r->value = r->getValue(); // leaves the register file
+        r->slot = -1;
+    }
+    sequential = std::move(kept);
+}
+
+/** places the cells between the nands of the levels below and above them, once the optimizations removed what they
+ * removed, and reads the nets their inputs were merged into */
+void GateKeeper::placeCells(const std::vector<int>& level) {
+    std::stable_sort(cellSteps.begin(), cellSteps.end(), [&level](const CellStep& a, const CellStep& b) {
+        return level[a.out] < level[b.out];
+    });
+    for (auto& c : cellSteps) {
+        c.before = std::lower_bound(nands.begin(), nands.end(), level[c.out], [&level](const NandStep& n, int l) {
+            return level[n.out] < l;
+        }) - nands.begin();
+    }
+    for (auto& in : cellInputs) in = representative[in];
+}
+
+void GateKeeper::tickLanes() {
+    const int W = laneWords;
+    for (auto in : inputs)
+        for (int w = 0; w < W; w++) lanes[in->id * W + w] = in->getLanes(w);
+    nandKernel(lanes.data(), nands.data(), nands.data() + nands.size());
+    for (size_t k = 0; k < registers.size(); k++)
+        std::copy_n(&lanes[registers[k].second * W], W, &nextLanes[k * W]);
+    for (auto& p : probes) p.first->showLanes(&lanes[p.second * W], W);
+    for (size_t k = 0; k < registers.size(); k++)
+        std::copy_n(&nextLanes[k * W], W, &lanes[registers[k].first * W]);
+}
+
+/** A compiled copy of a linked GateKeeper's netlist, without pointers and virtual calls. The nets are renumbered so the
+ * sources (low outputs, inputs and registers) come first and the nands follow in level order, so one pass over the
+ * opcodes computes a tick. A net costs an opcode, two 32-bit input indices and a bit of value, instead of a heap
+ * allocated gate with its name. The keeper is only read when compiling, the two simulate independently afterwards. */
+class FlatNetlist {
+    friend class BytecodeInterpreter;
+    friend class NativeNetlist;
+    friend class JitNetlist;
+    friend class PipelinedNetlist;
+    friend class LutNetlist;
+    friend class BatchNetlist;
+    friend class FaultSimulator;
+public:
+    enum Op : uint8_t { Low, In, Reg, NandOp };
+private:
+    struct Probe {
+        uint32_t net;
+        int t;
+        std::string name;
+    };
+    std::vector<uint8_t> ops; // by net
+    std::vector<uint32_t> in1, in2; // by net, the register's input is in1
+    std::vector<uint64_t> values, next; // packed bits by net
+    std::vector<uint32_t> registers; // nets of the registers
+    std::vector<Probe> probes;
+    std::vector<std::pair<std::string, uint32_t>> inputs; // by name
+    std::vector<uint32_t> netOf; // by the id of the gate in the keeper
+
+    bool get(uint32_t net) const { return values[net >> 6] >> (net & 63) & 1; }
+    static void put(std::vector<uint64_t>& bits, uint32_t net, bool v) {
+        uint64_t mask = 1ull << (net & 63);
+        bits[net >> 6] = v ? bits[net >> 6] | mask : bits[net >> 6] & ~mask;
+    }
+public:
+    explicit FlatNetlist(const GateKeeper& keeper) {
+        int n = keeper.getNumGates();
+        std::vector<int> level = keeper.computeLevels();
+        std::vector<int> order;
+        for (int i = 0; i < n; i++)
+            if (!dynamic_cast<const TickOutputOnly*>(keeper.getGate(i))) order.push_back(i);
+        std::stable_sort(order.begin(), order.end(), [&level](int a, int b) { return level[a] < level[b]; });
+        netOf.assign(n, UINT32_MAX);
+        for (int k = 0; k < (int)order.size(); k++) netOf[order[k]] = k;
+
+        size_t nets = order.size();
+        ops.resize(nets);
+        in1.assign(nets, 0);
+        in2.assign(nets, 0);
+        values.assign((nets + 63) / 64, 0);
+        next.assign(values.size(), 0);
+        for (uint32_t k = 0; k < nets; k++) {
+            const IGate* g = keeper.getGate(order[k]);
+            if (dynamic_cast<const Nand*>(g)) {
+                ops[k] = NandOp;
+                in1[k] = netOf[g->getInput(0)->getId()];
+                in2[k] = netOf[g->getInput(1)->getId()];
+            } else if (dynamic_cast<const Register*>(g)) {
+                ops[k] = Reg;
+                in1[k] = netOf[g->getInput(0)->getId()];
+                registers.push_back(k);
+                put(values, k, g->getValue());
+            } else if (auto in = dynamic_cast<const Input*>(g)) {
+                ops[k] = In;
+                inputs.push_back({in->getName(), k});
+                put(values, k, g->getValue());
+            } else if (dynamic_cast<const LowOutput*>(g)) {
+                ops[k] = Low;
+            } else {
+                throw std::runtime_error("gate " + keeper.getGateName(order[k]) + " not supported by FlatNetlist");
+            }
+        }
+        for (int i = 0; i < n; i++)
+            if (auto p = dynamic_cast<const TickOutputOnly*>(keeper.getGate(i)))
+                probes.push_back({netOf[p->getInput(0)->getId()], 0, p->getName()});
+    }
+    /** the value of a net in the keeper, in the last tick */
+    bool getValue(const IGate* gate) const { return get(netOf[gate->getId()]); }
+    void setInput(const std::string& name, bool value) {
+        for (auto& in : inputs)
+            if (in.first == name) put(values, in.second, value);
+    }
+    size_t getNumNets() const { return ops.size(); }
+    /** the bytes used by the netlist, excluding the names of the probes and inputs */
+    size_t getMemoryUsage() const {
+        return ops.size() + (in1.size() + in2.size() + registers.size() + netOf.size()) * sizeof(uint32_t)
+               + (values.size() + next.size()) * sizeof(uint64_t) + probes.size() * sizeof(Probe);
+    }
+    void tick() {
+        for (uint32_t k = 0; k < ops.size(); k++) {
+            switch (ops[k]) {
+            case Low: put(values, k, false); break;
+            case NandOp: put(values, k, !(get(in1[k]) && get(in2[k]))); break;
+            default: break;
+            }
+        }
+        for (uint32_t r : registers) put(next, r, get(in1[r]));
+        for (auto& p : probes)
+            std::cout << p.name.c_str() << ": tick" << ++p.t << ": " << (get(p.net) ? 'H' : 'L') << std::endl;
+        for (uint32_t r : registers) put(values, r, next[r >> 6] >> (r & 63) & 1);
+    }
+};
+
+/** Runs a FlatNetlist lowered into a linear instruction stream, dispatched with computed gotos where the compiler has
+ * them. A tick is NAND and LOW instructions in level order, then REG_LATCH of every register into a next-value slot,
+ * PROBE, and REG_COMMIT of the slots, keeping the two phases of the registers. Lowering is a single pass, so it starts
+ * up as fast as the FlatNetlist itself. */
+class BytecodeInterpreter {
+public:
+    enum Op : uint32_t { NAND, LOW, REG_LATCH, REG_COMMIT, PROBE, END };
+private:
+    std::vector<uint32_t> code; // opcodes followed by their operands
+    std::vector<char> values; // by net
+    std::vector<char> next; // by register
+    std::vector<std::pair<std::string, int>> probes; // name and tick count
+    std::vector<std::pair<std::string, uint32_t>> inputs;
+    std::vector<uint32_t> netOf;
+
+    void emit(std::initializer_list<uint32_t> instruction) { code.insert(code.end(), instruction); }
+public:
+    explicit BytecodeInterpreter(const FlatNetlist& flat) : inputs(flat.inputs), netOf(flat.netOf) {
+        uint32_t nets = (uint32_t)flat.ops.size();
+        values.assign(nets, false);
+        for (uint32_t k = 0; k < nets; k++) {
+            values[k] = flat.get(k);
+            if (flat.ops[k] == FlatNetlist::NandOp) emit({NAND, k, flat.in1[k], flat.in2[k]});
+            else if (flat.ops[k] == FlatNetlist::Low) emit({LOW, k});
+        }
+        for (uint32_t r = 0; r < flat.registers.size(); r++) emit({REG_LATCH, r, flat.in1[flat.registers[r]]});
+        for (uint32_t p = 0; p < flat.probes.size(); p++) {
+            emit({PROBE, p, flat.probes[p].net});
+            probes.push_back({flat.probes[p].name, flat.probes[p].t});
+        }
+        for (uint32_t r = 0; r < flat.registers.size(); r++) emit({REG_COMMIT, flat.registers[r], r});
+        emit({END});
+        next.assign(flat.registers.size(), false);
+    }
+    bool getValue(const IGate* gate) const { return values[netOf[gate->getId()]]; }
+    void setInput(const std::string& name, bool value) {
+        for (auto& in : inputs)
+            if (in.first == name) values[in.second] = value;
+    }
+    size_t getCodeSize() const { return code.size() * sizeof(uint32_t); }
+    void tick() {
+        const uint32_t* pc = code.data();
+        char* v = values.data();
+#ifdef __GNUC__
+        static void* const labels[] = { &&nand, &&low, &&latch, &&commit, &&probe, &&end };
+#define DISPATCH() goto *labels[*pc];
+#define CASE(label, op) label
+#else // the block below becomes the body of the switch
+#define DISPATCH() switch (*pc)
+#define CASE(label, op) case op
+#endif
+        for (;;) {
+            DISPATCH()
+            {
+            CASE(nand, NAND):
+                v[pc[1]] = !(v[pc[2]] && v[pc[3]]);
+                pc += 4;
+                continue;
+            CASE(low, LOW):
+                v[pc[1]] = false;
+                pc += 2;
+                continue;
+            CASE(latch, REG_LATCH):
+                next[pc[1]] = v[pc[2]];
+                pc += 3;
+                continue;
+            CASE(commit, REG_COMMIT):
+                v[pc[1]] = next[pc[2]];
+                pc += 3;
+                continue;
+            CASE(probe, PROBE): {
+                auto& p = probes[pc[1]];
+                std::cout << p.first.c_str() << ": tick" << ++p.second << ": " << (v[pc[2]] ? 'H' : 'L') << std::endl;
+                pc += 3;
+                continue;
+            }
+            CASE(end, END):
+                return;
+            }
+        }
+#undef DISPATCH
+#undef CASE
+    }
+};
+
+/** Runs a FlatNetlist as native code: a C++ translation unit with one straight-line tick function is generated, built
+ * into a shared library by the system compiler and loaded with dlopen. The nets are locals of the function, the
+ * registers, inputs and sampled probe values are fields of the state. The libraries are cached in cacheDir by a
+ * structural hash of the netlist, so the same design is only compiled once. */
+class NativeNetlist {
+    using TickFunction = void (*)(unsigned char* regs, const unsigned char* ins, unsigned char* probes);
+
+    std::vector<unsigned char> regs, ins, probeValues;
+    std::vector<std::pair<std::string, int>> probes; // name and tick count
+    std::vector<std::pair<std::string, uint32_t>> inputs; // name and index in ins
+    std::vector<int> regOf, inOf; // by net, -1 when not a register or input
+    std::vector<uint32_t> netOf;
+    void* library = nullptr;
+    TickFunction tickFunction = nullptr;
+
+    /** bumped whenever generate() or the tick function's arguments change, so older cached libraries are not loaded */
+    static constexpr uint64_t generatorVersion = 1;
+    static constexpr const char* compileCommand = "c++ -O1 -shared -fPIC";
+
+    /** the cache key: the netlist, the layout of the register and input buffers, the generator and the compiler */
+    static uint64_t hash(const FlatNetlist& flat) {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        auto add = [&h](uint64_t v) {
+            for (int i = 0; i < 8; i++, v >>= 8) h = (h ^ (v & 0xff)) * 1099511628211ull;
+        };
+        add(generatorVersion);
+        for (const char* c = compileCommand; *c; c++) add((unsigned char)*c);
+        add(flat.registers.size());
+        add(flat.inputs.size());
+        for (size_t k = 0; k < flat.ops.size(); k++) {
+            add(flat.ops[k]);
+            add(flat.in1[k]);
+            add(flat.in2[k]);
+        }
+        for (auto& p : flat.probes) add(p.net);
+        return h;
+    }
+    std::string generate(const FlatNetlist& flat) const {
+        std::ostringstream src;
+        src << "extern \"C\" void tick(unsigned char* r, const unsigned char* in, unsigned char* p) {\n";
+        for (uint32_t k = 0; k < flat.ops.size(); k++) {
+            src << "    const bool n" << k << " = ";
+            switch (flat.ops[k]) {
+            case FlatNetlist::Low: src << "false"; break;
+            case FlatNetlist::In: src << "in[" << inOf[k] << "]"; break;
+            case FlatNetlist::Reg: src << "r[" << regOf[k] << "]"; break;
+            case FlatNetlist::NandOp: src << "!(n" << flat.in1[k] << " && n" << flat.in2[k] << ")"; break;
+            }
+            src << ";\n";
+        }
+        for (size_t i = 0; i < flat.probes.size(); i++) src << "    p[" << i << "] = n" << flat.probes[i].net << ";\n";
+        // every net is read before the first commit, so the commits need no next value buffer
+        for (auto r : flat.registers) src << "    r[" << regOf[r] << "] = n" << flat.in1[r] << ";\n";
+        src << "}\n";
+        return src.str();
+    }
+    /** $XDG_CACHE_HOME/circuit-simulator, or ~/.cache/circuit-simulator, or a directory in /tmp named after the user */
+    static std::string defaultCacheDir() {
+        const char* xdg = std::getenv("XDG_CACHE_HOME");
+        if (xdg && *xdg) return std::string(xdg) + "/circuit-simulator";
+        const char* home = std::getenv("HOME");
+        if (home && *home) return std::string(home) + "/.cache/circuit-simulator";
+        return "/tmp/circuit-simulator-" + std::to_string(geteuid());
+    }
+    /** creates the missing directories of the path private to the user, and refuses a cache directory another user
+     * could write a library into, as the libraries in it are loaded without further checks */
+    static void prepareCacheDir(const std::string& dir) {
+        for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+            std::string path = dir.substr(0, slash);
+            if (!path.empty() && mkdir(path.c_str(), 0700) != 0 && errno != EEXIST)
+                throw std::runtime_error("could not create " + path + ": " + std::strerror(errno));
+            if (slash == std::string::npos) break;
+        }
+        struct stat st;
+        if (lstat(dir.c_str(), &st) != 0) throw std::runtime_error("could not stat " + dir + ": " + std::strerror(errno));
+        if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0)
+            throw std::runtime_error(dir + " must be a directory owned by the user and accessible only to them");
+    }
+public:
+    /** the libraries are cached in cacheDir, the default one if empty */
+    explicit NativeNetlist(const FlatNetlist& flat, std::string cacheDir = "") : netOf(flat.netOf) {
+        uint32_t nets = (uint32_t)flat.ops.size();
+        regOf.assign(nets, -1);
+        inOf.assign(nets, -1);
+        for (auto r : flat.registers) {
+            regOf[r] = (int)regs.size();
+            regs.push_back(flat.get(r));
+        }
+        for (auto& in : flat.inputs) {
+            inOf[in.second] = (int)ins.size();
+            inputs.push_back({in.first, (uint32_t)ins.size()});
+            ins.push_back(flat.get(in.second));
+        }
+        for (auto& p : flat.probes) probes.push_back({p.name, p.t});
+        probeValues.assign(probes.size(), 0);
+
+        if (cacheDir.empty()) cacheDir = defaultCacheDir();
+        prepareCacheDir(cacheDir);
+        std::ostringstream name;
+        name << cacheDir << "/netlist-" << std::hex << std::setw(16) << std::setfill('0') << hash(flat);
+        std::string so = name.str() + ".so";
+        library = dlopen(so.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library) {
+            // the source and the library are written under names of this run and renamed, so a concurrent run never
+            // compiles a half written source or loads a half written library
+            std::string tmp = name.str() + "." + std::to_string(getpid()) + "."
+                              + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+            {
+                std::ofstream out(tmp + ".cpp");
+                out << generate(flat);
+                if (!out.flush()) throw std::runtime_error("could not write " + tmp + ".cpp");
+            }
+            std::string cmd = std::string(compileCommand) + " -o '" + tmp + ".so' '" + tmp + ".cpp'";
+            bool compiled = std::system(cmd.c_str()) == 0;
+            std::rename((tmp + ".cpp").c_str(), (name.str() + ".cpp").c_str()); // kept only to be read
+            if (!compiled) throw std::runtime_error("could not compile " + name.str() + ".cpp");
+            if (std::rename((tmp + ".so").c_str(), so.c_str()) != 0) throw std::runtime_error("could not rename " + tmp + ".so");
+            library = dlopen(so.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!library) throw std::runtime_error(dlerror());
+        }
+        tickFunction = (TickFunction)dlsym(library, "tick");
+        if (!tickFunction) throw std::runtime_error(dlerror());
+    }
+    NativeNetlist(const NativeNetlist&)=delete;
+    NativeNetlist& operator=(const NativeNetlist&)=delete;
+    ~NativeNetlist() { if (library) dlclose(library); }
+    /** the value of a register or input of the keeper */
+    bool getValue(const IGate* gate) const {
+        uint32_t net = netOf[gate->getId()];
+        assert((regOf[net] >= 0 || inOf[net] >= 0) && "only the registers and inputs are kept between ticks");
+        return regOf[net] >= 0 ? regs[regOf[net]] : ins[inOf[net]];
+    }
+    void setInput(const std::string& name, bool value) {
+        for (auto& in : inputs)
+            if (in.first == name) ins[in.second] = value;
+    }
+    void tick() {
+        tickFunction(regs.data(), ins.data(), probeValues.data());
+        for (size_t i = 0; i < probes.size(); i++)
+            std::cout << probes[i].first.c_str() << ": tick" << ++probes[i].second << ": " << (probeValues[i] ? 'H' : 'L')
+                      << std::endl;
+    }
+};
+
+#ifdef HAS_X86_KERNELS
+/** Runs a FlatNetlist as x86-64 machine code generated into an mmap'd buffer, without an external compiler. Every net is
+ * a 64-bit word, so the code simulates 64 lanes at once like the BitParallel engine, and a single value is all ones or
+ * zero. The generated function takes the net words in rdi and the latched values in rsi. Recently computed nets stay in
+ * the seven free scratch registers, evicting the least recently used one, so most nand inputs are not loaded again.
+ * It is not a GateKeeper engine, like the BytecodeInterpreter and the NativeNetlist: the generated code owns the net
+ * words, so the gates could no longer answer getValue() or be ticked virtually, which the keeper's flip-flops, cells and
+ * memories rely on. It simulates the FlatNetlist of a design of nands and registers, read through getValue(). */
+class JitNetlist {
+    using TickFunction = void (*)(uint64_t* nets, uint64_t* latched);
+    enum : uint8_t { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7, R8 = 8, R9 = 9, R10 = 10, R11 = 11 };
+    static constexpr uint8_t scratch[] = { RAX, RCX, RDX, R8, R9, R10, R11 };
+
+    std::vector<uint64_t> nets, latched; // latched: the registers' next values, then the probes' values
+    std::vector<uint32_t> registers;
+    std::vector<std::pair<std::string, int>> probes; // name and tick count
+    std::vector<std::pair<std::string, uint32_t>> inputs;
+    std::vector<uint32_t> netOf;
+    void* buffer = nullptr;
+    size_t bufferSize = 0;
+    TickFunction tickFunction = nullptr;
+
+    // used while generating
+    std::vector<uint8_t> code;
+    struct Slot { int64_t net = -1; uint64_t used = 0; };
+    std::array<Slot, sizeof(scratch)> slots;
+    uint64_t clock = 0;
+
+    void rex(uint8_t reg, uint8_t rm) { code.push_back(0x48 | (reg >> 3) << 2 | rm >> 3); }
+    void modrm(uint8_t mod, uint8_t reg, uint8_t rm) { code.push_back(mod << 6 | (reg & 7) << 3 | (rm & 7)); }
+    /** op reg, [base + disp32] or op [base + disp32], reg; base is rdi or rsi */
+    void memOp(uint8_t op, uint8_t reg, uint8_t base, uint32_t index) {
+        assert(index < (1u << 28) && "the byte offset of a word must fit the signed 32-bit displacement");
+        rex(reg, base);
+        code.push_back(op);
+        modrm(2, reg, base);
+        uint32_t disp = index * 8;
+        for (int i = 0; i < 4; i++) code.push_back(disp >> 8 * i & 0xff);
+    }
+    void load(uint8_t reg, uint8_t base, uint32_t index) { memOp(0x8b, reg, base, index); }
+    void store(uint8_t reg, uint8_t base, uint32_t index) { memOp(0x89, reg, base, index); }
+    /** op rm, reg between registers */
+    void regOp(uint8_t op, uint8_t rm, uint8_t reg) {
+        rex(reg, rm);
+        code.push_back(op);
+        modrm(3, reg, rm);
+    }
+    void notReg(uint8_t reg) {
+        rex(0, reg);
+        code.push_back(0xf7);
+        modrm(3, 2, reg);
+    }
+    /** a slot for a new value, not evicting the slots in use */
+    int allocate(int keep1 = -1, int keep2 = -1) {
+        int best = -1;
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (i == keep1 || i == keep2) continue;
+            if (best < 0 || slots[i].used < slots[best].used) best = i;
+        }
+        return best;
+    }
+    /** the slot holding the net, loading it if needed */
+    int fetch(uint32_t net, int keep = -1) {
+        for (int i = 0; i < (int)slots.size(); i++)
+            if (slots[i].net == net) {
+                slots[i].used = ++clock;
+                return i;
+            }
+        int i = allocate(keep);
+        load(scratch[i], RDI, net);
+        slots[i] = {net, ++clock};
+        return i;
+    }
+public:
+    explicit JitNetlist(const FlatNetlist& flat)
+        : registers(flat.registers), inputs(flat.inputs), netOf(flat.netOf) {
+        uint32_t n = (uint32_t)flat.ops.size();
+        nets.assign(n, 0);
+        for (uint32_t k = 0; k < n; k++) nets[k] = flat.get(k) ? ~0ull : 0;
+        for (auto& p : flat.probes) probes.push_back({p.name, p.t});
+        latched.assign(registers.size() + probes.size(), 0);
+
+        for (uint32_t k = 0; k < n; k++) {
+            if (flat.ops[k] == FlatNetlist::NandOp) {
+                int a = fetch(flat.in1[k]);
+                int b = fetch(flat.in2[k], a);
+                int d = allocate(a, b);
+                regOp(0x89, scratch[d], scratch[a]); // mov d, a
+                regOp(0x21, scratch[d], scratch[b]); // and d, b
+                notReg(scratch[d]);
+                store(scratch[d], RDI, k);
+                slots[d] = {k, ++clock};
+            } else if (flat.ops[k] == FlatNetlist::Low) {
+                int d = allocate();
+                regOp(0x31, scratch[d], scratch[d]); // xor d, d
+                store(scratch[d], RDI, k);
+                slots[d] = {k, ++clock};
+            }
+        }
+        for (uint32_t r = 0; r < registers.size(); r++) store(scratch[fetch(flat.in1[registers[r]])], RSI, r);
+        for (uint32_t p = 0; p < probes.size(); p++)
+            store(scratch[fetch(flat.probes[p].net)], RSI, (uint32_t)registers.size() + p);
+        for (uint32_t r = 0; r < registers.size(); r++) {
+            load(RAX, RSI, r);
+            store(RAX, RDI, registers[r]);
+        }
+        code.push_back(0xc3); // ret
+
+        bufferSize = code.size();
+        buffer = mmap(nullptr, bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED) throw std::runtime_error("could not map the jit buffer");
+        std::copy(code.begin(), code.end(), (uint8_t*)buffer);
+        if (mprotect(buffer, bufferSize, PROT_READ | PROT_EXEC) != 0) {
+            munmap(buffer, bufferSize); // the destructor is not run when the constructor throws
+            throw std::runtime_error("could not protect the jit buffer");
+        }
+        tickFunction = (TickFunction)buffer;
+        code = {};
+    }
+    JitNetlist(const JitNetlist&)=delete;
+    JitNetlist& operator=(const JitNetlist&)=delete;
+    ~JitNetlist() { munmap(buffer, bufferSize); }
+    size_t getCodeSize() const { return bufferSize; }
+    bool getValue(const IGate* gate) const { return nets[netOf[gate->getId()]] & 1; }
+    uint64_t getLanes(const IGate* gate) const { return nets[netOf[gate->getId()]]; }
+    void setLanes(const std::string& name, uint64_t lanes) {
+        for (auto& in : inputs)
+            if (in.first == name) nets[in.second] = lanes;
+    }
+    void setInput(const std::string& name, bool value) { setLanes(name, value ? ~0ull : 0); }
+    void tick() {
+        tickFunction(nets.data(), latched.data());
+        for (size_t i = 0; i < probes.size(); i++)
+            std::cout << probes[i].first.c_str() << ": tick" << ++probes[i].second << ": "
+                      << (latched[registers.size() + i] & 1 ? 'H' : 'L') << std::endl;
+    }
+};
+#endif
+
+/** moves the registers' values into the register file, keeping the ones already there */
+void GateKeeper::buildRegisterFile() {
+    std::vector<Register*> regs;
+    std::vector<char> initial;
+    ticking.clear();
+    for (auto g : sequential) {
+        if (auto r = dynamic_cast<Register*>(g)) {
+            regs.push_back(r);
+            initial.push_back(r->getValue());
+        } else if (!dynamic_cast<Input*>(g)) {
+            ticking.push_back(g);
+        }
+    }
+    registerIds.clear();
+    registerInputs.clear();
+    registerBits.assign((regs.size() + 63) / 64, 0);
+    nextRegisterBits.assign(registerBits.size(), 0);
+    for (int k = 0; k < (int)regs.size(); k++) {
+        regs[k]->slot = k;
+        registerIds.push_back(regs[k]->id);
+        registerInputs.push_back(representative[regs[k]->getInput(0)->id]);
+        if (initial[k]) registerBits[k >> 6] |= 1ull << (k & 63);
+    }
+}
+
+void GateKeeper::run(uint64_t numTicks) {
+    if (!levelized) levelize();
+    std::vector<TickOutputOnly*> shown;
+    bool canSkip = fastForward && usesRegisterFile();
+    for (auto c : ticking) {
+        auto p = dynamic_cast<TickOutputOnly*>(c);
+        canSkip = canSkip && p;
+        shown.push_back(p);
+    }
+    // Brent's cycle detection: the state saved at a power of two ticks is compared with the following ones, so once
+    // the saved state is in the cycle, it repeats after exactly one period, with the probe values recorded since
+    std::vector<uint64_t> saved = registerBits;
+    uint64_t power = 1, period = 0;
+    std::vector<char> probeValues; // by tick since the saved state, then by probe
+    canSkip = canSkip && saved.size() * sizeof(uint64_t) + power * shown.size() <= maxRecordedBytes;
+    for (uint64_t done = 0; done < numTicks; done++) {
+        if (canSkip && period > 0 && registerBits == saved) {
+            // ticks from here on repeat the last period: the whole periods are replayed, the rest is ticked
+            uint64_t left = numTicks - done, skipped = left - left % period;
+            for (uint64_t r = 0; !shown.empty() && r < skipped; r++)
+                for (size_t i = 0; i < shown.size(); i++) shown[i]->show(probeValues[r % period * shown.size() + i]);
+            done += skipped;
+            canSkip = false;
+            if (done == numTicks) break;
+        }
+        if (canSkip && period == power) {
+            saved = registerBits;
+            power *= 2;
+            period = 0;
+            probeValues.clear();
+            canSkip = saved.size() * sizeof(uint64_t) + power * shown.size() <= maxRecordedBytes;
+        }
+        tick();
+        simulatedTicks++;
+        if (!canSkip) continue;
+        period++;
+        for (auto p : shown) probeValues.push_back(getComputedValue(p->getInput(0)->id));
+    }
+}
+
+/** gives the input cone of every register and probe to a partition, the one where it costs the least: the partition's
+ * nands plus the nands of the cone the partition does not have yet, so overlapping cones end up together */
+void GateKeeper::partition() {
+    int n = (int)gates.size();
+    std::vector<IGate*> sinks;
+    for (auto g : sequential) {
+        assert(g->getNumInputs() <= 1 && "flip-flops are not supported by the Partitioned engine");
+        if (g->getNumInputs() == 1) sinks.push_back(g); // registers and probes
+    }
+    std::vector<int> stepOf(n, -1); // by gate id, the index in nands
+    for (int k = 0; k < (int)nands.size(); k++) stepOf[nands[k].out] = k;
+    std::vector<std::vector<int>> cones(sinks.size());
+    std::vector<int> seenBy(n, -1);
+    for (int s = 0; s < (int)sinks.size(); s++) {
+        std::vector<int> stack = {representative[sinks[s]->getInput(0)->id]};
+        while (!stack.empty()) {
+            int c = stack.back();
+            stack.pop_back();
+            if (seenBy[c] == s) continue;
+            seenBy[c] = s;
+            cones[s].push_back(c);
+            if (stepOf[c] < 0) continue;
+            stack.push_back(nands[stepOf[c]].in1);
+            stack.push_back(nands[stepOf[c]].in2);
+        }
+    }
+    std::vector<int> order(sinks.size());
+    for (int s = 0; s < (int)order.size(); s++) order[s] = s;
+    std::stable_sort(order.begin(), order.end(), [&cones](int a, int b) { return cones[a].size() > cones[b].size(); });
+
+    int numPartitions = std::max(1, std::min(threads, (int)sinks.size()));
+    std::vector<std::vector<char>> member(numPartitions, std::vector<char>(n, false));
+    std::vector<size_t> load(numPartitions, 0);
+    std::vector<int> owner(sinks.size());
+    for (int s : order) {
+        int best = 0;
+        size_t bestCost = SIZE_MAX;
+        for (int p = 0; p < numPartitions; p++) {
+            size_t added = 0;
+            for (int c : cones[s]) added += !member[p][c];
+            if (load[p] + added < bestCost) best = p, bestCost = load[p] + added;
+        }
+        owner[s] = best;
+        load[best] = bestCost;
+        for (int c : cones[s]) member[best][c] = true;
+    }
+
+    partitions.assign(numPartitions, {});
+    std::vector<int> localOf(n, -1);
+    std::vector<char> exported(n, false);
+    for (int p = 0; p < numPartitions; p++) {
+        Partition& part = partitions[p];
+        int size = 0;
+        for (int i = 0; i < n; i++)
+            if (member[p][i] && stepOf[i] < 0) {
+                localOf[i] = size++;
+                if (!folded[i]) part.sources.push_back({i, localOf[i]});
+            }
+        for (auto& nand : nands)
+            if (member[p][nand.out]) {
+                localOf[nand.out] = size++;
+                part.steps.push_back({localOf[nand.out], localOf[nand.in1], localOf[nand.in2]});
+            }
+        part.local.assign(size, false);
+        for (int i = 0; i < n; i++) // the folded nands are set once here, instead of being evaluated every tick
+            if (member[p][i] && folded[i]) part.local[localOf[i]] = values[i];
+        for (int s = 0; s < (int)sinks.size(); s++) {
+            if (owner[s] != p) continue;
+            int in = representative[sinks[s]->getInput(0)->id];
+            if (auto r = dynamic_cast<Register*>(sinks[s])) part.latches.push_back({r, localOf[in]});
+            else if (!exported[in]) part.exports.push_back({localOf[in], in}), exported[in] = true;
+        }
+    }
+    if (!pool || pool->getNumThreads() != numPartitions) pool = std::make_unique<SpinningPool>(numPartitions);
+}
+
+/** a nand read by exactly one nand, and nothing else, is put in the task of its reader, so every task is a fanout-free
+ * cone, and a path can only leave a task through its root: the tasks cannot wait for each other in a loop */
+void GateKeeper::buildTasks() {
+    int n = (int)gates.size();
+    std::vector<int> nandReaders(n, 0), reader(n, -1);
+    std::vector<char> readByOthers(n, false);
+    for (auto& nand : nands) {
+        nandReaders[nand.in1]++, reader[nand.in1] = nand.out;
+        if (nand.in2 != nand.in1) nandReaders[nand.in2]++, reader[nand.in2] = nand.out;
+    }
+    for (auto g : sequential)
+        for (int j = 0; j < g->getNumInputs(); j++) readByOthers[representative[g->getInput(j)->id]] = true;
+    std::vector<int> taskOf(n, -1);
+    int numTasks = 0;
+    for (int k = (int)nands.size() - 1; k >= 0; k--) {
+        int out = nands[k].out;
+        taskOf[out] = nandReaders[out] == 1 && !readByOthers[out] ? taskOf[reader[out]] : numTasks++;
+    }
+    taskStart.assign(numTasks + 1, 0);
+    for (auto& nand : nands) taskStart[taskOf[nand.out] + 1]++;
+    for (int t = 0; t < numTasks; t++) taskStart[t + 1] += taskStart[t];
+    std::vector<NandStep> ordered(nands.size());
+    std::vector<int> filled(taskStart.begin(), taskStart.end() - 1);
+    for (auto& nand : nands) ordered[filled[taskOf[nand.out]]++] = nand; // keeps the level order inside a task
+    nands = std::move(ordered);
+
+    std::vector<std::vector<int>> succ(numTasks);
+    for (auto& nand : nands)
+        for (int in : {nand.in1, nand.in2})
+            if (taskOf[in] >= 0 && taskOf[in] != taskOf[nand.out]) succ[taskOf[in]].push_back(taskOf[nand.out]);
+    successorStart.assign(numTasks + 1, 0);
+    successors.clear();
+    dependencies.assign(numTasks, 0);
+    for (int t = 0; t < numTasks; t++) {
+        std::sort(succ[t].begin(), succ[t].end());
+        succ[t].erase(std::unique(succ[t].begin(), succ[t].end()), succ[t].end());
+        for (int s : succ[t]) dependencies[s]++;
+        successors.insert(successors.end(), succ[t].begin(), succ[t].end());
+        successorStart[t + 1] = (int)successors.size();
+    }
+    remaining.reset(new std::atomic<int>[numTasks]);
+    workerQueues.reset(new WorkerQueue[threads]);
+    if (!pool || pool->getNumThreads() != threads) pool = std::make_unique<SpinningPool>(threads);
+}
+
+void GateKeeper::tickWorkStealing() {
+    for (int i : sources) values[i] = gates[i].second->getValue();
+    const int numTasks = getNumTasks();
+    for (int t = 0; t < numTasks; t++) {
+        remaining[t].store(dependencies[t], std::memory_order_relaxed);
+        if (!dependencies[t]) workerQueues[t % threads].tasks.push_back(t);
+    }
+    std::atomic<int> done{0};
+    pool->run([&](int w) {
+        auto take = [&](int& task) {
+            for (int i = 0; i < threads; i++) {
+                WorkerQueue& q = workerQueues[(w + i) % threads];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                if (q.tasks.empty()) continue;
+                if (i == 0) {
+                    task = q.tasks.back();
+                    q.tasks.pop_back();
+                } else {
+                    task = q.tasks.front();
+                    q.tasks.pop_front();
+                    steals.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+            return false;
+        };
+        int task;
+        while (done.load(std::memory_order_acquire) < numTasks) {
+            if (!take(task)) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (int k = taskStart[task]; k < taskStart[task + 1]; k++) {
+                auto& n = nands[k];
+                values[n.out] = !(values[n.in1] && values[n.in2]);
+            }
+            for (int k = successorStart[task]; k < successorStart[task + 1]; k++) {
+                int s = successors[k];
+                if (remaining[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(workerQueues[w].mutex);
+                    workerQueues[w].tasks.push_back(s);
+                }
+            }
+            done.fetch_add(1, std::memory_order_release);
+        }
+    });
+    valuesComputed = true;
+    for (auto c : sequential) c->tick1();
+    valuesComputed = false;
+    invalidate();
+    for (auto c : sequential) c->tick2();
+}
+
+void GateKeeper::tickPartitioned() {
+    pool->run([this](int w) {
+        Partition& part = partitions[w];
+        char* v = part.local.data();
+        for (auto& s : part.sources) v[s.second] = gates[s.first].second->getValue();
+        for (auto& n : part.steps) v[n.out] = !(v[n.in1] && v[n.in2]);
+        for (auto& l : part.latches) l.first->latch(v[l.second]);
+        for (auto& e : part.exports) values[e.second] = v[e.first];
+    });
+    valuesComputed = true;
+    for (auto c : sequential)
+        if (!dynamic_cast<Register*>(c)) c->tick1();
+    valuesComputed = false;
+    invalidate();
+    for (auto c : sequential) c->tick2();
+}
+
+void GateKeeper::tickParallel() {
+    for (int i : sources) values[i] = gates[i].second->getValue();
+    valuesComputed = true;
+    if (!pool) {
+        for (auto& n : nands) values[n.out] = !(values[n.in1] && values[n.in2]);
+        for (auto c : sequential) c->tick1();
+        valuesComputed = false;
+        invalidate();
+        for (auto c : sequential) c->tick2();
+        return;
+    }
+    const int T = threads;
+    const bool parallelRegisters = (int)registerGates.size() >= minLevelWidth;
+    auto chunk = [T](int b, int e, int w) { return std::make_pair(b + (int)((int64_t)(e - b) * w / T), b + (int)((int64_t)(e - b) * (w + 1) / T)); };
+    auto forRegisters = [&](int w, void (IGate::*phase)()) {
+        if (!parallelRegisters && w != 0) return;
+        auto r = parallelRegisters ? chunk(0, (int)registerGates.size(), w) : std::make_pair(0, (int)registerGates.size());
+        for (int i = r.first; i < r.second; i++) (registerGates[i]->*phase)();
+    };
+    pool->run([&](int w) {
+        for (auto& ph : phases) {
+            if (!ph.parallel && w != 0) {
+                barrier->wait();
+                continue;
+            }
+            auto r = ph.parallel ? chunk(ph.begin, ph.end, w) : std::make_pair(ph.begin, ph.end);
+            for (int k = r.first; k < r.second; k++) {
+                auto& n = nands[k];
+                values[n.out] = !(values[n.in1] && values[n.in2]);
+            }
+            barrier->wait();
+        }
+        forRegisters(w, &IGate::tick1);
+    });
+    for (auto c : otherSequential) c->tick1();
+    valuesComputed = false;
+    invalidate();
+    pool->run([&](int w) { forRegisters(w, &IGate::tick2); });
+    for (auto c : otherSequential) c->tick2();
+}
+
+/** A bounded lock-free queue between one producer and one consumer thread */
+template<typename T>
+class SpscRing {
+    std::vector<T> slots;
+    std::atomic<size_t> head{0}, tail{0}; // popped and pushed items
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity) {}
+    void push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        SpinBarrier::spinUntil([&] { return t - head.load(std::memory_order_acquire) < slots.size(); });
+        slots[t % slots.size()] = item;
+        tail.store(t + 1, std::memory_order_release);
+    }
+    void pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        SpinBarrier::spinUntil([&] { return tail.load(std::memory_order_acquire) != h; });
+        item = slots[h % slots.size()];
+        head.store(h + 1, std::memory_order_release);
+    }
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+/** Runs a feed-forward FlatNetlist as a software pipeline. A register's stage is one more than the stage of the
+ * registers its input is computed from, the inputs and lows being stage 0. Thread k computes the nands reading stage k
+ * for tick t while thread k+1 is still at tick t-1, and the values latched into the stage k+1 registers are passed on
+ * in a bounded queue. The probes' values are buffered and shown in tick order after the run.
+ * If a register is in a feedback loop, or a net mixes stages, the design is not a pipeline and it is simulated by the
+ * FlatNetlist, one tick after the other. */
+class PipelinedNetlist {
+    struct Stage {
+        std::vector<uint32_t> nands; // in level order
+        std::vector<uint32_t> registers; // of this stage, set from the queue
+        std::vector<uint32_t> latches; // the inputs of the registers of the next stage
+        std::vector<uint32_t> probes; // indexes of the probes reading this stage
+    };
+    FlatNetlist flat;
+    std::vector<Stage> stages;
+    std::vector<int> stageOfRegister; // by net, -1 for the others
+    bool pipeline = true;
+    static constexpr size_t queueTicks = 64;
+public:
+    explicit PipelinedNetlist(const FlatNetlist& netlist) : flat(netlist) {
+        const int unknown = -3, mixed = -2, constant = -1;
+        uint32_t n = (uint32_t)flat.ops.size();
+        std::vector<int> stage(n, unknown);
+        for (uint32_t k = 0; k < n; k++)
+            if (flat.ops[k] == FlatNetlist::Low) stage[k] = constant;
+            else if (flat.ops[k] == FlatNetlist::In) stage[k] = 0;
+        auto combine = [&](int a, int b) {
+            if (a == unknown || b == unknown) return unknown;
+            if (a == mixed || b == mixed) return mixed;
+            if (a == constant) return b;
+            if (b == constant || a == b) return a;
+            return mixed;
+        };
+        // every pass gives the stage of at least one more register, unless there is a feedback loop
+        for (size_t pass = 0; pass <= flat.registers.size(); pass++) {
+            for (uint32_t k = 0; k < n; k++)
+                if (flat.ops[k] == FlatNetlist::NandOp) stage[k] = combine(stage[flat.in1[k]], stage[flat.in2[k]]);
+            bool changed = false;
+            for (uint32_t r : flat.registers) {
+                int in = stage[flat.in1[r]];
+                if (stage[r] == unknown && in != unknown) {
+                    stage[r] = in == mixed ? mixed : std::max(in, 0) + 1;
+                    changed = true;
+                }
+            }
+            if (!changed) break;
+        }
+        int numStages = 1;
+        for (uint32_t r : flat.registers) {
+            if (stage[r] < 0) pipeline = false;
+            numStages = std::max(numStages, stage[r] + 1);
+        }
+        for (auto& p : flat.probes)
+            if (stage[p.net] == mixed || stage[p.net] == unknown) pipeline = false;
+        if (!pipeline) return;
+
+        stages.resize(numStages);
+        stageOfRegister.assign(n, -1);
+        for (uint32_t k = 0; k < n; k++) {
+            if (flat.ops[k] == FlatNetlist::NandOp) {
+                if (stage[k] == constant) // every stage computes the constants it may read
+                    for (auto& st : stages) st.nands.push_back(k);
+                else if (stage[k] >= 0)
+                    stages[stage[k]].nands.push_back(k);
+            } else if (flat.ops[k] == FlatNetlist::Reg) {
+                stageOfRegister[k] = stage[k];
+                stages[stage[k]].registers.push_back(k);
+                stages[std::max(stage[flat.in1[k]], 0)].latches.push_back(flat.in1[k]);
+            }
+        }
+        for (uint32_t i = 0; i < flat.probes.size(); i++) stages[std::max(stage[flat.probes[i].net], 0)].probes.push_back(i);
+    }
+    bool isPipeline() const { return pipeline; }
+    int getNumStages() const { return (int)stages.size(); }
+    bool getValue(const IGate* gate) const { return flat.getValue(gate); }
+    /** may only be called from the stimulus of run() */
+    void setInput(const std::string& name, bool value) { flat.setInput(name, value); }
+    /** runs ticks, calling stimulus before each of them to set the inputs */
+    void run(int ticks, const std::function<void(int tick)>& stimulus = {}) {
+        if (!pipeline) {
+            for (int t = 0; t < ticks; t++) {
+                if (stimulus) stimulus(t);
+                flat.tick();
+            }
+            return;
+        }
+        int S = (int)stages.size();
+        std::vector<std::unique_ptr<SpscRing<std::vector<char>>>> queues; // queues[k]: from stage k to stage k+1
+        for (int k = 0; k < S; k++) queues.push_back(std::make_unique<SpscRing<std::vector<char>>>(queueTicks));
+        std::vector<std::vector<char>> probeValues(S);
+        std::vector<char> initial(flat.ops.size()); // the registers' and inputs' values, before the stimulus changes them
+        for (uint32_t i = 0; i < flat.ops.size(); i++) initial[i] = flat.get(i);
+        SpinningPool pool(S);
+        pool.run([&](int k) {
+            Stage& st = stages[k];
+            std::vector<char> v = initial, latched(st.latches.size()), incoming(st.registers.size());
+            probeValues[k].reserve((size_t)ticks * st.probes.size());
+            for (int t = 0; t < ticks; t++) {
+                if (k == 0) {
+                    if (stimulus) stimulus(t);
+                    for (auto& in : flat.inputs) v[in.second] = flat.get(in.second);
+                }
+                if (k > 0 && t > 0) {
+                    queues[k - 1]->pop(incoming);
+                    for (size_t i = 0; i < st.registers.size(); i++) v[st.registers[i]] = incoming[i];
+                }
+                for (uint32_t i : st.nands) v[i] = !(v[flat.in1[i]] && v[flat.in2[i]]);
+                for (uint32_t p : st.probes) probeValues[k].push_back(v[flat.probes[p].net]);
+                if (k + 1 < S) {
+                    for (size_t i = 0; i < st.latches.size(); i++) latched[i] = v[st.latches[i]];
+                    queues[k]->push(latched);
+                }
+            }
+        });
+        // the values latched on the last tick are the registers' state after the run
+        std::vector<char> last;
+        for (int k = 0; k + 1 < S; k++) {
+            while (!queues[k]->empty()) queues[k]->pop(last);
+            if (ticks == 0) continue;
+            for (size_t i = 0; i < stages[k + 1].registers.size(); i++)
+                FlatNetlist::put(flat.values, stages[k + 1].registers[i], last[i]);
+        }
+        std::vector<size_t> read(S, 0);
+        for (int t = 0; t < ticks; t++) {
+            std::vector<std::pair<uint32_t, bool>> shown;
+            for (int k = 0; k < S; k++)
+                for (uint32_t p : stages[k].probes) shown.push_back({p, probeValues[k][read[k]++]});
+            std::sort(shown.begin(), shown.end());
+            for (auto& sh : shown) {
+                auto& p = flat.probes[sh.first];
+                std::cout << p.name.c_str() << ": tick" << ++p.t << ": " << (sh.second ? 'H' : 'L') << std::endl;
+            }
+        }
+    }
+};
+
+/** Runs a FlatNetlist mapped onto lookup tables of up to 6 inputs. The k-feasible cuts of every nand are enumerated in
+ * level order, keeping the few shallowest and smallest ones, and the netlist is covered backward from the nets the
+ * registers and probes read, each cover being a cell with a 64-bit truth table computed from its cone. A cell is one
+ * table lookup in a tick, so an xor, six nands, is a single cell. Only the cells' outputs, the registers and the inputs
+ * have values. */
+class LutNetlist {
+public:
+    static constexpr int MaxInputs = 6;
+private:
+    struct Cut {
+        std::array<uint32_t, MaxInputs> leaves;
+        int size;
+        int depth;
+    };
+    struct LutCell {
+        uint32_t out;
+        int size;
+        std::array<uint32_t, MaxInputs> leaves;
+        uint64_t table; // bit i is the output for the leaves' values being the bits of i
+    };
+    static constexpr int cutsPerNet = 8;
+    FlatNetlist flat;
+    std::vector<LutCell> cells; // in level order
+    std::vector<char> values; // by net
+    std::vector<char> next; // by register
+
+    /** the union of two cuts, or false if it has more than k leaves */
+    static bool merge(const Cut& a, const Cut& b, int k, Cut& result) {
+        int i = 0, j = 0;
+        result.size = 0;
+        while (i < a.size || j < b.size) {
+            uint32_t next = j == b.size || (i < a.size && a.leaves[i] < b.leaves[j]) ? a.leaves[i] : b.leaves[j];
+            if (i < a.size && a.leaves[i] == next) i++;
+            if (j < b.size && b.leaves[j] == next) j++;
+            if (result.size == k) return false;
+            result.leaves[result.size++] = next;
+        }
+        return true;
+    }
+public:
+    explicit LutNetlist(const FlatNetlist& netlist, int k = MaxInputs) : flat(netlist) {
+        assert(k >= 2 && k <= MaxInputs);
+        uint32_t n = (uint32_t)flat.ops.size();
+        std::vector<std::vector<Cut>> cuts(n); // the non-trivial cuts of every nand, the best first
+        std::vector<int> depth(n, 0);
+        auto withTrivial = [&](uint32_t net) {
+            std::vector<Cut> all = cuts[net];
+            Cut trivial{};
+            trivial.leaves[0] = net, trivial.size = 1, trivial.depth = depth[net];
+            all.push_back(trivial);
+            return all;
+        };
+        for (uint32_t v = 0; v < n; v++) {
+            if (flat.ops[v] != FlatNetlist::NandOp) continue;
+            std::vector<Cut> found;
+            for (auto& a : withTrivial(flat.in1[v]))
+                for (auto& b : withTrivial(flat.in2[v])) {
+                    Cut c;
+                    if (!merge(a, b, k, c)) continue;
+                    c.depth = 0;
+                    for (int i = 0; i < c.size; i++) c.depth = std::max(c.depth, depth[c.leaves[i]] + 1);
+                    bool duplicate = false;
+                    for (auto& f : found)
+                        duplicate = duplicate || (f.size == c.size && std::equal(f.leaves.begin(), f.leaves.begin() + c.size, c.leaves.begin()));
+                    if (!duplicate) found.push_back(c);
+                }
+            std::sort(found.begin(), found.end(), [](const Cut& a, const Cut& b) {
+                return a.depth != b.depth ? a.depth < b.depth : a.size < b.size;
+            });
+            if (found.size() > cutsPerNet) found.resize(cutsPerNet);
+            depth[v] = found.front().depth;
+            cuts[v] = std::move(found);
+        }
+
+        std::vector<char> required(n, false);
+        for (uint32_t r : flat.registers) required[flat.in1[r]] = true;
+        for (auto& p : flat.probes) required[p.net] = true;
+        std::vector<uint64_t> word(n, 0);
+        std::vector<uint32_t> inCone(n, UINT32_MAX); // the output of the cell whose cone the net was last put in
+        const uint64_t variables[MaxInputs] = { 0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+                                                0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull };
+        for (uint32_t v = n; v-- > 0;) { // the readers come later in level order, so they are required before
+            if (!required[v] || flat.ops[v] != FlatNetlist::NandOp) continue;
+            const Cut& best = cuts[v].front();
+            LutCell cell{v, best.size, best.leaves, 0};
+            // the cone between the leaves and the output, computed on all the leaves' values at once
+            std::vector<uint32_t> cone, stack = {v};
+            for (int i = 0; i < best.size; i++) {
+                inCone[best.leaves[i]] = v;
+                word[best.leaves[i]] = variables[i];
+                required[best.leaves[i]] = true;
+            }
+            while (!stack.empty()) {
+                uint32_t c = stack.back();
+                stack.pop_back();
+                if (inCone[c] == v) continue;
+                inCone[c] = v;
+                cone.push_back(c);
+                stack.push_back(flat.in1[c]);
+                stack.push_back(flat.in2[c]);
+            }
+            std::sort(cone.begin(), cone.end());
+            for (uint32_t c : cone) word[c] = ~(word[flat.in1[c]] & word[flat.in2[c]]);
+            cell.table = word[v];
+            cells.push_back(cell);
+        }
+        std::reverse(cells.begin(), cells.end());
+        values.assign(n, false);
+        for (uint32_t v = 0; v < n; v++) values[v] = flat.get(v);
+        next.assign(flat.registers.size(), false);
+    }
+    size_t getNumCells() const { return cells.size(); }
+    /** the value of a register, an input, or a net computed by a cell in the last tick */
+    bool getValue(const IGate* gate) const { return values[flat.netOf[gate->getId()]]; }
+    void setInput(const std::string& name, bool value) {
+        for (auto& in : flat.inputs)
+            if (in.first == name) values[in.second] = value;
+    }
+    void tick() {
+        char* v = values.data();
+        for (auto& cell : cells) {
+            unsigned index = 0;
+            for (int i = 0; i < cell.size; i++) index |= (unsigned)v[cell.leaves[i]] << i;
+            v[cell.out] = cell.table >> index & 1;
+        }
+        for (size_t r = 0; r < next.size(); r++) next[r] = v[flat.in1[flat.registers[r]]];
+        for (auto& p : flat.probes)
+            std::cout << p.name.c_str() << ": tick" << ++p.t << ": " << (v[p.net] ? 'H' : 'L') << std::endl;
+        for (size_t r = 0; r < next.size(); r++) v[flat.registers[r]] = next[r];
+    }
+};
+
+/** Runs many instances of a FlatNetlist at once, each with its own inputs, registers and probes. The topology is stored
+ * once and every net has a lane by instance, 64 instances to a word, so one pass over the nets ticks all the instances
+ * with word operations. An instance costs a bit by net instead of a copy of the gates, their names and their wiring. */
+class BatchNetlist {
+    FlatNetlist flat;
+    const int instances;
+    const int words; // by net
+    std::vector<uint64_t> lanes; // words by net, instance i is bit i % 64 of word i / 64
+    std::vector<uint64_t> next; // words by register
+    std::vector<uint64_t> probeLanes; // words by probe, the values the probes read in the last tick
+
+    uint64_t* at(uint32_t net) { return &lanes[(size_t)net * words]; }
+    const uint64_t* at(uint32_t net) const { return &lanes[(size_t)net * words]; }
+    static bool bit(const uint64_t* l, int instance) { return l[instance >> 6] >> (instance & 63) & 1; }
+    static void put(uint64_t* l, int instance, bool v) {
+        uint64_t mask = 1ull << (instance & 63);
+        l[instance >> 6] = v ? l[instance >> 6] | mask : l[instance >> 6] & ~mask;
+    }
+public:
+    /** every instance starts from the register values and inputs of the netlist */
+    BatchNetlist(const FlatNetlist& netlist, int instances)
+        : flat(netlist), instances(instances), words((instances + 63) / 64) {
+        assert(instances >= 1);
+        uint32_t n = (uint32_t)flat.ops.size();
+        lanes.assign((size_t)n * words, 0);
+        for (uint32_t k = 0; k < n; k++)
+            if (flat.get(k)) std::fill_n(at(k), words, ~0ull);
+        next.assign(flat.registers.size() * words, 0);
+        probeLanes.assign(flat.probes.size() * words, 0);
+    }
+    int getNumInstances() const { return instances; }
+    /** the bytes used by the topology, which is shared, and by the state of all the instances */
+    size_t getMemoryUsage() const {
+        return flat.getMemoryUsage() + (lanes.size() + next.size() + probeLanes.size()) * sizeof(uint64_t);
+    }
+    /** the value of a net of the keeper in an instance, in the last tick */
+    bool getValue(const IGate* gate, int instance) const { return bit(at(flat.netOf[gate->getId()]), instance); }
+    /** the index of an input by its name, or -1 */
+    int findInput(const std::string& name) const {
+        for (int i = 0; i < (int)flat.inputs.size(); i++)
+            if (flat.inputs[i].first == name) return i;
+        return -1;
+    }
+    void setInput(int input, int instance, bool value) { put(at(flat.inputs[input].second), instance, value); }
+    void setInput(const std::string& name, int instance, bool value) { setInput(findInput(name), instance, value); }
+    int getNumProbes() const { return (int)flat.probes.size(); }
+    const std::string& getProbeName(int probe) const { return flat.probes[probe].name; }
+    /** the value a probe showed in an instance in the last tick */
+    bool getProbeValue(int probe, int instance) const { return bit(&probeLanes[(size_t)probe * words], instance); }
+    void tick() {
+        const int W = words;
+        for (uint32_t k = 0; k < flat.ops.size(); k++) {
+            uint64_t* out = at(k);
+            switch (flat.ops[k]) {
+            case FlatNetlist::Low: std::fill_n(out, W, 0); break;
+            case FlatNetlist::NandOp: {
+                const uint64_t *a = at(flat.in1[k]), *b = at(flat.in2[k]);
+                for (int w = 0; w < W; w++) out[w] = ~(a[w] & b[w]);
+                break;
+            }
+            default: break;
+            }
+        }
+        for (size_t r = 0; r < flat.registers.size(); r++)
+            std::copy_n(at(flat.in1[flat.registers[r]]), W, &next[r * W]);
+        for (size_t p = 0; p < flat.probes.size(); p++)
+            std::copy_n(at(flat.probes[p].net), W, &probeLanes[p * W]);
+        for (size_t r = 0; r < flat.registers.size(); r++)
+            std::copy_n(&next[r * W], W, at(flat.registers[r]));
+    }
+};
+
+/** Simulates the stuck-at-0 and stuck-at-1 faults of every net of a keeper's netlist, a fault being detected when a probe
+ * shows another value than without it. Lane 0 of a word is the good machine and the other 63 lanes are faulty machines
+ * with a fault each, all running the same input vectors from the initial state, so a pass over the vectors simulates
+ * 63 faults. A pass stops once its faults are all detected, and the detected faults are dropped from the next passes
+ * and runs. Faults known to be equivalent through a nand are simulated once: a net read only by one nand stuck at 0
+ * is the nand stuck at 1, and both stuck-at faults of a net read only by a not are the not's opposite ones. */
+class FaultSimulator {
+public:
+    static constexpr int FaultsPerPass = 63;
+private:
+    FlatNetlist flat;
+    std::vector<std::string> names; // by net, the long name of its gate
+    std::vector<int> representative; // by fault, the equivalent fault simulated instead, the fault being net * 2 + value
+    std::vector<int> detectedBy; // by fault, the index of the first vector detecting it in its run, or -1
+    std::vector<uint64_t> lanes, next; // by net, and by register
+    std::vector<uint64_t> clear, set; // by net, the lanes forced to 0 and to 1 in the current pass
+
+    int find(int fault) const {
+        while (representative[fault] != fault) fault = representative[fault];
+        return fault;
+    }
+    void force(uint32_t net) { lanes[net] = (lanes[net] & ~clear[net]) | set[net]; }
+public:
+    /** with collapse false, every fault is simulated on its own */
+    explicit FaultSimulator(const GateKeeper& keeper, bool collapse = true) : flat(keeper) {
+        uint32_t n = (uint32_t)flat.ops.size();
+        names.assign(n, "");
+        for (int id = 0; id < keeper.getNumGates(); id++)
+            if (flat.netOf[id] != UINT32_MAX) names[flat.netOf[id]] = keeper.getGateName(id);
+        representative.resize(n * 2);
+        for (uint32_t f = 0; f < n * 2; f++) representative[f] = f;
+        detectedBy.assign(n * 2, -1);
+        lanes.assign(n, 0);
+        next.assign(flat.registers.size(), 0);
+        clear.assign(n, 0);
+        set.assign(n, 0);
+        if (!collapse) return;
+        std::vector<int> reads(n, 0), reader(n, -1); // reads by nands, counting both inputs of a not once
+        std::vector<char> observed(n, false);
+        for (uint32_t k = 0; k < n; k++) {
+            if (flat.ops[k] != FlatNetlist::NandOp) continue;
+            reads[flat.in1[k]]++, reader[flat.in1[k]] = k;
+            if (flat.in2[k] != flat.in1[k]) reads[flat.in2[k]]++, reader[flat.in2[k]] = k;
+        }
+        for (uint32_t r : flat.registers) observed[flat.in1[r]] = true;
+        for (auto& p : flat.probes) observed[p.net] = true;
+        for (uint32_t k = 0; k < n; k++) {
+            if (reads[k] != 1 || observed[k]) continue;
+            uint32_t r = reader[k];
+            representative[k * 2 + 0] = r * 2 + 1;
+            if (flat.in1[r] == flat.in2[r]) representative[k * 2 + 1] = r * 2 + 0;
+        }
     }
-    bool getValue() const override {
-        return val;
+    /** the faults, excluding a low output stuck at 0, which is no fault */
+    int getNumFaults() const {
+        return (int)representative.size() - (int)std::count(flat.ops.begin(), flat.ops.end(), FlatNetlist::Low);
+    }
+    /** the faults left after collapsing the equivalent ones */
+    int getNumCollapsedFaults() const {
+        int classes = 0;
+        for (int f = 0; f < (int)representative.size(); f++)
+            classes += representative[f] == f && !(f % 2 == 0 && flat.ops[f / 2] == FlatNetlist::Low);
+        return classes;
+    }
+    bool isDetected(int fault) const { return detectedBy[find(fault)] >= 0; }
+    int getNumDetected() const {
+        int detected = 0;
+        for (int f = 0; f < (int)representative.size(); f++)
+            detected += !(f % 2 == 0 && flat.ops[f / 2] == FlatNetlist::Low) && isDetected(f);
+        return detected;
+    }
+    /** the fault of a gate of the keeper stuck at the value */
+    int getFault(const IGate* gate, bool value) const { return (int)flat.netOf[gate->getId()] * 2 + value; }
+    /** the index of the first vector detecting the fault in its run, or -1 */
+    int getDetectingVector(int fault) const { return detectedBy[find(fault)]; }
+    /** the detected and all the faults by level of the hierarchy: by every prefix of the long names ending with a
+     * prototype's type */
+    std::map<std::string, std::pair<int, int>> getCoverageByLevel() const {
+        std::map<std::string, std::pair<int, int>> coverage;
+        for (int f = 0; f < (int)representative.size(); f++) {
+            if (f % 2 == 0 && flat.ops[f / 2] == FlatNetlist::Low) continue;
+            const std::string& name = names[f / 2];
+            bool detected = isDetected(f);
+            for (size_t end = name.find("] "); end != std::string::npos; end = name.find("] ", end + 2)) {
+                auto& c = coverage[name.substr(0, end + 2)];
+                c.first += detected;
+                c.second++;
+            }
+        }
+        return coverage;
+    }
+    /** applies the vectors, one a tick, from the initial state of the netlist. A vector has a value by named input, the
+     * other inputs keep their values. Returns the number of faults newly detected */
+    int run(const std::vector<std::string>& inputNames, const std::vector<std::vector<bool>>& vectors) {
+        std::vector<uint32_t> inputNets;
+        for (auto& name : inputNames) {
+            auto it = std::find_if(flat.inputs.begin(), flat.inputs.end(), [&name](auto& in) { return in.first == name; });
+            assert(it != flat.inputs.end() && "no such input");
+            inputNets.push_back(it->second);
+        }
+        std::vector<int> pending;
+        for (int f = 0; f < (int)representative.size(); f++)
+            if (representative[f] == f && detectedBy[f] < 0 && !(f % 2 == 0 && flat.ops[f / 2] == FlatNetlist::Low))
+                pending.push_back(f);
+        const uint32_t n = (uint32_t)flat.ops.size();
+        int found = 0;
+        for (size_t first = 0; first < pending.size(); first += FaultsPerPass) {
+            int faults = (int)std::min<size_t>(FaultsPerPass, pending.size() - first);
+            for (int j = 0; j < faults; j++) {
+                int f = pending[first + j];
+                (f % 2 ? set : clear)[f / 2] |= 2ull << j;
+            }
+            for (uint32_t k = 0; k < n; k++) {
+                lanes[k] = flat.get(k) ? ~0ull : 0;
+                force(k);
+            }
+            uint64_t undetected = ((2ull << faults) - 1) & ~1ull; // lanes 1 to faults
+            for (int v = 0; v < (int)vectors.size() && undetected; v++) {
+                for (size_t i = 0; i < inputNets.size(); i++) {
+                    lanes[inputNets[i]] = vectors[v][i] ? ~0ull : 0;
+                    force(inputNets[i]);
+                }
+                for (uint32_t k = 0; k < n; k++) {
+                    if (flat.ops[k] == FlatNetlist::NandOp) lanes[k] = ~(lanes[flat.in1[k]] & lanes[flat.in2[k]]);
+                    else if (flat.ops[k] != FlatNetlist::Low) continue;
+                    force(k);
+                }
+                uint64_t differs = 0;
+                for (auto& p : flat.probes) differs |= lanes[p.net] ^ (lanes[p.net] & 1 ? ~0ull : 0);
+                for (uint64_t d = differs & undetected; d; d &= d - 1) {
+                    detectedBy[pending[first + __builtin_ctzll(d) - 1]] = v;
+                    found++;
+                }
+                undetected &= ~differs;
+                for (size_t r = 0; r < flat.registers.size(); r++) next[r] = lanes[flat.in1[flat.registers[r]]];
+                for (size_t r = 0; r < flat.registers.size(); r++) {
+                    lanes[flat.registers[r]] = next[r];
+                    force(flat.registers[r]);
+                }
+            }
+            for (int j = 0; j < faults; j++) clear[pending[first + j] / 2] = set[pending[first + j] / 2] = 0;
+        }
+        return found;
     }
 };
 
@@ -145,24 +2637,30 @@ public:
 /** a circuit from a gate */
 template<typename T>
 class GateCircuit : public ICircuit {
-    IGate* c ;
+    std::array<IGate*, T::OutputSize> c; // a gate by output, constructed with the index of its output if there are several
 public:
     template<typename... Args>
     GateCircuit(GateKeeper* heimdall, const LongNameBuilder& builder, Args&&... args) {
-        auto cc = std::make_unique<T>(std::forward<Args>(args)...);
-        c = cc.get();
-        LongNameBuilder builder2 = builder;
-        builder2.addType(c->getType());
-        heimdall->addGate(builder2, std::move(cc));
+        for (int i = 0; i < T::OutputSize; i++) {
+            std::unique_ptr<T> cc;
+            if constexpr (T::OutputSize == 1) cc = std::make_unique<T>(std::forward<Args>(args)...);
+            else cc = std::make_unique<T>(i, args...);
+            c[i] = cc.get();
+            LongNameBuilder builder2 = builder;
+            builder2.addType(c[i]->getType());
+            heimdall->addGate(builder2, std::move(cc));
+        }
     }
     IGate* getOutput(int i) override {
-        assert(i == 0);
-        return c;
+        assert(i >= 0 && i < T::OutputSize);
+        return c[i];
     }
     void link(const std::vector<IGate*>& args) override {
-        assert((int)args.size() == c->getNumInputs());
-        for (int i = 0; i < (int)args.size(); i++)
-            c->getInput(i) = args[i];
+        for (auto g : c) {
+            assert((int)args.size() == g->getNumInputs());
+            for (int i = 0; i < (int)args.size(); i++)
+                g->getInput(i) = args[i];
+        }
     }
 };
 
@@ -174,17 +2672,22 @@ public:
     virtual std::unique_ptr<ICircuit> instantiate(GateKeeper*, const LongNameBuilder&) const=0;
     int getNumInputs() const { return numInputs; }
     int getNumOutputs() const { return numOutputs; }
+    /** true if the circuits are made of nands, low outputs and cells only */
+    virtual bool isCombinational() const { return false; }
     virtual ~IPrototype() {}
 };
 
 /** A prototype for a simple gate */
 template<typename T, int N = T::InputSize>
 class GatePrototype : public IPrototype {
-    GatePrototype() : IPrototype(N, 1) {}
+    GatePrototype() : IPrototype(N, T::OutputSize) {}
 public:
     std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
         return std::make_unique<GateCircuit<T>>(heimdall, builder);
     }
+    bool isCombinational() const override {
+        return std::is_base_of<Cell, T>::value || std::is_same<T, Nand>::value || std::is_same<T, LowOutput>::value;
+    }
     inline static GatePrototype* getInstance() {
         static GatePrototype instance;
         return &instance;
@@ -206,6 +2709,83 @@ public:
     }
 };
 
+/** A prototype for an Input gate */
+class InputPrototype : public IPrototype {
+    const std::string name;
+public:
+    InputPrototype(std::string name) : IPrototype(0,1), name(name) {}
+    std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
+        return std::make_unique<GateCircuit<Input>>(heimdall, builder, name);
+    }
+};
+
+/** A prototype for a word-level primitive of the given operand width, see WordOp */
+class WordPrototype : public IPrototype {
+    const WordOp::Op op;
+    const int width;
+public:
+    WordPrototype(WordOp::Op op, int width) : IPrototype(WordOp::numInputsOf(op, width), 1), op(op), width(width) {
+        assert(op != WordOp::Bit && "use a SplitPrototype");
+    }
+    std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
+        return std::make_unique<GateCircuit<WordOp>>(heimdall, builder, op, width);
+    }
+};
+
+/** A prototype for a WordRegister gate */
+class WordRegisterPrototype : public IPrototype {
+    const int width;
+public:
+    WordRegisterPrototype(int width) : IPrototype(1,1), width(width) {}
+    std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
+        return std::make_unique<GateCircuit<WordRegister>>(heimdall, builder, width);
+    }
+};
+
+/** A prototype for a Memory gate, initialized from the file if one is given */
+class MemoryPrototype : public IPrototype {
+    const size_t depth;
+    const int width;
+    const bool readOnly;
+    const std::string file;
+public:
+    MemoryPrototype(size_t depth, int width, bool readOnly = false, std::string file = "")
+        : IPrototype(readOnly ? 1 : 3, 1), depth(depth), width(width), readOnly(readOnly), file(std::move(file)) {}
+    std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
+        return std::make_unique<GateCircuit<Memory>>(heimdall, builder, depth, width, readOnly, file);
+    }
+};
+
+/** A prototype splitting a bus net into its bits, lowest first: a WordOp::Bit gate by output */
+class SplitPrototype : public IPrototype {
+    const int width;
+
+    class Circuit : public ICircuit {
+        std::vector<IGate*> outputs;
+    public:
+        Circuit(GateKeeper* heimdall, const LongNameBuilder& builder, int width) {
+            for (int i = 0; i < width; i++) {
+                auto gate = std::make_unique<WordOp>(WordOp::Bit, width, i);
+                outputs.push_back(gate.get());
+                LongNameBuilder builder2 = builder;
+                builder2.addType(gate->getType());
+                builder2.addChildId(std::to_string(i));
+                heimdall->addGate(builder2, std::move(gate));
+            }
+        }
+        IGate* getOutput(int i) override { return outputs.at(i); }
+        void link(const std::vector<IGate*>& args) override {
+            assert(args.size() == 1);
+            for (auto g : outputs) g->getInput(0) = args[0];
+        }
+    };
+public:
+    SplitPrototype(int width) : IPrototype(1, width), width(width) {}
+    std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder) const override {
+        return std::make_unique<Circuit>(heimdall, builder, width);
+    }
+};
+
 /** Stores the information of how to build a bigger circuit from a smaller one. */
 class CompositePrototype : public IPrototype {
 
@@ -221,6 +2801,8 @@ class CompositePrototype : public IPrototype {
     const std::vector<std::string> outer_output_ids;
     int num_nodes = -1;
     const std::string type_name;
+    bool combinational = true; // only combinational prototypes in it
+    std::vector<std::shared_ptr<const std::vector<uint64_t>>> rows; // the truth table by output, if tabulated
 
     class Circuit : public ICircuit {
         enum { Init, Linked } state;
@@ -271,7 +2853,59 @@ class CompositePrototype : public IPrototype {
             }
         }
     };
+
+    /** the cell of a tabulated prototype: a TruthTable gate by output */
+    class TableCircuit : public ICircuit {
+        std::vector<IGate*> outputs;
+    public:
+        TableCircuit(GateKeeper* heimdall, const LongNameBuilder& builder, const CompositePrototype* parent) {
+            for (int i = 0; i < parent->getNumOutputs(); i++) {
+                auto gate = std::make_unique<TruthTable>(parent->getNumInputs(), parent->rows[i]);
+                outputs.push_back(gate.get());
+                LongNameBuilder builder2 = builder;
+                builder2.addType(parent->type_name);
+                builder2.addChildId(parent->outer_output_ids[i]);
+                builder2.addType(gate->getType());
+                heimdall->addGate(builder2, std::move(gate));
+            }
+        }
+        IGate* getOutput(int i) override { return outputs.at(i); }
+        void link(const std::vector<IGate*>& args) override {
+            for (auto g : outputs) {
+                assert((int)args.size() == g->getNumInputs());
+                for (int i = 0; i < (int)args.size(); i++)
+                    g->getInput(i) = args[i];
+            }
+        }
+    };
+
+    /** evaluates the outputs for every combination of the inputs with the Lazy engine, the first input being the
+     * lowest bit of the combination */
+    void tabulate() {
+        GateKeeper scratch(GateKeeper::Engine::Lazy);
+        std::vector<IGate*> args;
+        std::vector<Input*> inputs;
+        std::vector<std::unique_ptr<ICircuit>> inputCircuits;
+        for (auto& id : outer_input_ids) {
+            inputCircuits.push_back(std::make_unique<GateCircuit<Input>>(&scratch, LongNameBuilder(), id));
+            args.push_back(inputCircuits.back()->getOutput(0));
+            inputs.push_back(static_cast<Input*>(args.back()));
+        }
+        Circuit circuit(&scratch, LongNameBuilder(), this);
+        circuit.link(args);
+        uint32_t combinations = 1u << getNumInputs();
+        std::vector<std::vector<uint64_t>> table(getNumOutputs(), std::vector<uint64_t>((combinations + 63) / 64, 0));
+        for (uint32_t c = 0; c < combinations; c++) {
+            for (int i = 0; i < getNumInputs(); i++) inputs[i]->setValue(c >> i & 1);
+            for (int k = 0; k < getNumOutputs(); k++)
+                if (circuit.getOutput(k)->getValue()) table[k][c >> 6] |= 1ull << (c & 63);
+        }
+        for (auto& row : table) rows.push_back(std::make_shared<const std::vector<uint64_t>>(std::move(row)));
+    }
 public:
+    /** the most inputs a prototype can have to be tabulated, its table has a bit by output and input combination */
+    static constexpr int MaxTableInputs = 16;
+
     CompositePrototype(std::string name, std::vector<std::string> outer_input_ids, std::vector<std::string> outer_output_ids)
         : IPrototype(outer_input_ids.size(), outer_output_ids.size()), state(Init),
             outer_input_ids(std::move(outer_input_ids)), outer_output_ids(std::move(outer_output_ids)), type_name(std::move(name)) {
@@ -281,17 +2915,26 @@ public:
         if (dynamic_cast<const CompositePrototype*>(&cmd)) {
             assert(dynamic_cast<const CompositePrototype*>(&cmd)->state == Finalized);
         }
+        combinational = combinational && cmd.isCombinational();
         assert(cmd.getNumInputs() == (int)input_ids.size());
         assert(cmd.getNumOutputs() == (int)output_ids.size());
         assert(state == Init);
         num_nodes += (int)output_ids.size();
         commands.push_back({&cmd, input_ids, output_ids, childName});
     }
-    void finalize() {
+    /** with tabulate, a combinational prototype of at most MaxTableInputs inputs is instantiated as a TruthTable gate
+     * by output instead of its nands. The other prototypes are instantiated as they are */
+    void finalize(bool tabulate = false) {
         assert(state == Init);
         state = Finalized;
+        if (tabulate && isTabulable()) this->tabulate();
     }
+    bool isCombinational() const override { return combinational; }
+    /** true if the prototype has no registers, inputs or outputs in it, and few enough inputs to be tabulated */
+    bool isTabulable() const { return combinational && getNumInputs() <= MaxTableInputs; }
+    bool isTabulated() const { return !rows.empty(); }
     std::unique_ptr<ICircuit> instantiate(GateKeeper* heimdall, const LongNameBuilder& builder=LongNameBuilder()) const override {
+        if (isTabulated()) return std::make_unique<TableCircuit>(heimdall, builder, this);
         return std::make_unique<Circuit>(heimdall, builder, this);
     }
 };
@@ -352,8 +2995,9 @@ int main() {
     adderPrototype.addPrototype(orPrototype, {"12+13", "32"}, {"carry"});
     adderPrototype.finalize();
 
-    CompositePrototype adder8Prototype("8+8 bit adder",
-            {"a8", "a7", "a6", "a5", "a4", "a3", "a2", "a1", "b8", "b7", "b6", "b5", "b4", "b3", "b2", "b1"}, {"c8", "c7", "c6", "c5", "c4", "c3", "c2", "c1", "carry"});
+    const std::vector<std::string> adder8Inputs = {"a8", "a7", "a6", "a5", "a4", "a3", "a2", "a1", "b8", "b7", "b6", "b5", "b4", "b3", "b2", "b1"};
+    const std::vector<std::string> adder8Outputs = {"c8", "c7", "c6", "c5", "c4", "c3", "c2", "c1", "carry"};
+    CompositePrototype adder8Prototype("8+8 bit adder", adder8Inputs, adder8Outputs);
     adder8Prototype.addPrototype(lowPrototype, {}, {"carry0"});
     adder8Prototype.addPrototype(adderPrototype, {"a1", "b1", "carry0"}, {"c1", "carry1"});
     adder8Prototype.addPrototype(adderPrototype, {"a2", "b2", "carry1"}, {"c2", "carry2"});
@@ -365,6 +3009,26 @@ int main() {
     adder8Prototype.addPrototype(adderPrototype, {"a8", "b8", "carry7"}, {"c8", "carry"});
     adder8Prototype.finalize();
 
+    // the stimulus and the check shared by the 8+8 bit adder tests: the vector v gives the input i adder8Input(v, i), a1
+    // being the lowest bit of v and b8 the highest, and the output k shows adder8Output(v, k), c8 being the highest bit
+    // of the sum and the carry coming last
+    std::vector<InputPrototype> adder8InputPrototypes(adder8Inputs.begin(), adder8Inputs.end());
+    auto addAdder8Inputs = [&](CompositePrototype& proto) {
+        for (int i = 0; i < 16; i++)
+            proto.addPrototype(adder8InputPrototypes[i], {}, {adder8Inputs[i]});
+    };
+    auto adder8Input = [](int v, int i) { return (bool)((v >> (i < 8 ? 7 - i : 15 - i + 8)) & 1); };
+    auto adder8Output = [](int v, int k) { return (bool)((((v & 0xff) + (v >> 8)) >> (k < 8 ? 7 - k : 8)) & 1); };
+    // the 64 lanes of the input i, the lane l given the vector first + l
+    auto adder8InputLanes = [&](int first, int i) {
+        uint64_t l = 0;
+        for (int lane = 0; lane < 64; lane++) l |= (uint64_t)adder8Input(first + lane, i) << lane;
+        return l;
+    };
+    auto setAdder8Inputs = [&](GateKeeper& keeper, int v) {
+        for (int i = 0; i < 16; i++) keeper.findInput(adder8Inputs[i])->setValue(adder8Input(v, i));
+    };
+
     CompositePrototype clkPrototype("clock", {}, {"out"});
     clkPrototype.addPrototype(registerPrototype, {"in"}, {"out"});
     clkPrototype.addPrototype(notPrototype, {"out"}, {"in"});
@@ -450,4 +3114,915 @@ int main() {
         for (int i = 0; i < 24; i++)
             heimdall.tick(),std::cout << std::endl;
     }
+    {
+        // the workers of an idle pool park, and the next job wakes them
+        SpinningPool pool(4);
+        std::atomic<int> ran{0};
+        for (int round = 0; round < 3; round++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            pool.run([&](int) { ran++; });
+        }
+        assert(ran == 12);
+    }
+    for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy, GateKeeper::Engine::EventDriven,
+                        GateKeeper::Engine::LevelParallel, GateKeeper::Engine::Partitioned,
+                        GateKeeper::Engine::WorkStealing}) {
+        // registers sample the same values during a tick as the recursive evaluation gives
+        GateKeeper heimdall(engine);
+        heimdall.setParallelism(4, 1); // small enough to use the threads on every level
+        CompositePrototype testProto("test", {}, {"sum", "carry", "sampled sum", "sampled carry"});
+        testProto.addPrototype(clkPrototype, {}, {"clk/1"});
+        testProto.addPrototype(halverPrototype, {"clk/1"}, {"clk/2"});
+        testProto.addPrototype(halverPrototype, {"clk/2"}, {"clk/4"});
+        testProto.addPrototype(adderPrototype, {"clk/1", "clk/2", "clk/4"}, {"sum", "carry"});
+        testProto.addPrototype(registerPrototype, {"sum"}, {"sampled sum"});
+        testProto.addPrototype(registerPrototype, {"carry"}, {"sampled carry"});
+        testProto.finalize();
+
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        for (int i = 0; i < 24; i++) {
+            bool sum = test->getOutput(0)->getValue(), carry = test->getOutput(1)->getValue();
+            heimdall.tick();
+            assert(test->getOutput(2)->getValue() == sum && test->getOutput(3)->getValue() == carry);
+        }
+        if (engine == GateKeeper::Engine::EventDriven)
+            std::cout << "event driven activity factor: " << heimdall.getActivityFactor() << std::endl;
+        if (engine == GateKeeper::Engine::Partitioned)
+            std::cout << "partitioned duplication: " << heimdall.getDuplication() << std::endl;
+        if (engine == GateKeeper::Engine::WorkStealing)
+            std::cout << "work stealing: " << heimdall.getNumTasks() << " tasks" << std::endl;
+    }
+    {
+        // the flat netlist, the interpreter, the native and the jit code tick the same as the keeper they are compiled
+        // from
+        GateKeeper heimdall;
+        CompositePrototype testProto("test", {}, {"sum", "carry", "sampled sum", "sampled carry"});
+        testProto.addPrototype(clkPrototype, {}, {"clk/1"});
+        testProto.addPrototype(halverPrototype, {"clk/1"}, {"clk/2"});
+        testProto.addPrototype(halverPrototype, {"clk/2"}, {"clk/4"});
+        testProto.addPrototype(adderPrototype, {"clk/1", "clk/2", "clk/4"}, {"sum", "carry"});
+        testProto.addPrototype(registerPrototype, {"sum"}, {"sampled sum"});
+        testProto.addPrototype(registerPrototype, {"carry"}, {"sampled carry"});
+        testProto.finalize();
+
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        FlatNetlist flat(heimdall);
+        BytecodeInterpreter interpreter(flat);
+        NativeNetlist native(flat);
+#ifdef HAS_X86_KERNELS
+        JitNetlist jit(flat);
+#endif
+        for (int i = 0; i < 24; i++) {
+            heimdall.tick();
+            flat.tick();
+            interpreter.tick();
+            native.tick();
+#ifdef HAS_X86_KERNELS
+            jit.tick();
+#endif
+            for (int k = 2; k < 4; k++) { // the registers, the nands are only computed during a tick
+                assert(flat.getValue(test->getOutput(k)) == test->getOutput(k)->getValue());
+                assert(interpreter.getValue(test->getOutput(k)) == test->getOutput(k)->getValue());
+                assert(native.getValue(test->getOutput(k)) == test->getOutput(k)->getValue());
+#ifdef HAS_X86_KERNELS
+                assert(jit.getValue(test->getOutput(k)) == test->getOutput(k)->getValue());
+#endif
+            }
+        }
+        std::cout << "flat netlist: " << (double)flat.getMemoryUsage() / flat.getNumNets() << " bytes per net" << std::endl;
+        // a cache directory other users can write to is refused
+        std::string shared = "/tmp/circuit-simulator-shared-" + std::to_string(getpid());
+        mkdir(shared.c_str(), 0700);
+        chmod(shared.c_str(), 0777);
+        bool refused = false;
+        try {
+            NativeNetlist unsafe(flat, shared);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        rmdir(shared.c_str());
+        assert(refused);
+    }
+#ifdef HAS_X86_KERNELS
+    {
+        // the jit adds all 2^16 pairs of the 8+8 bit adder, 64 per tick, then compiles a design of 100k nands
+        GateKeeper heimdall;
+        CompositePrototype testProto("test", {}, adder8Outputs);
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        for (int copy = 0; copy < 600; copy++) {
+            std::vector<std::string> outputs;
+            for (int k = 0; k < 9; k++) outputs.push_back("copy" + std::to_string(copy) + "/" + std::to_string(k));
+            testProto.addPrototype(adder8Prototype, adder8Inputs, outputs);
+        }
+        testProto.finalize();
+
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        auto start = std::chrono::steady_clock::now();
+        FlatNetlist flat(heimdall);
+        JitNetlist jit(flat);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        for (int word = 0; word < (1 << 16) / 64; word += 97) {
+            for (int i = 0; i < 16; i++) jit.setLanes(adder8Inputs[i], adder8InputLanes(word * 64, i));
+            jit.tick();
+            for (int lane = 0; lane < 64; lane++)
+                for (int k = 0; k < 9; k++)
+                    assert((bool)((jit.getLanes(test->getOutput(k)) >> lane) & 1) == adder8Output(word * 64 + lane, k));
+        }
+        std::cout << "jit: " << flat.getNumNets() << " nets flattened and compiled to " << jit.getCodeSize()
+                  << " bytes in " << elapsed.count() << " ms" << std::endl;
+    }
+#endif
+    {
+        // a pipeline of an adder, registers sampling it, an xor of them and a register sampling that shows the same as the
+        // keeper ticking one after the other
+        InputPrototype in1("in1"), in2("in2"), in3("in3");
+        OutputPrototype sumOut("sum"), carryOut("carry"), xorOut("xor");
+        CompositePrototype testProto("test", {}, {"xor register"});
+        testProto.addPrototype(in1, {}, {"1"});
+        testProto.addPrototype(in2, {}, {"2"});
+        testProto.addPrototype(in3, {}, {"3"});
+        testProto.addPrototype(adderPrototype, {"1", "2", "3"}, {"sum", "carry"});
+        testProto.addPrototype(registerPrototype, {"sum"}, {"sum register"});
+        testProto.addPrototype(registerPrototype, {"carry"}, {"carry register"});
+        testProto.addPrototype(sumOut, {"sum register"}, {});
+        testProto.addPrototype(carryOut, {"carry register"}, {});
+        testProto.addPrototype(xorPrototype, {"sum register", "carry register"}, {"xor"});
+        testProto.addPrototype(registerPrototype, {"xor"}, {"xor register"});
+        testProto.addPrototype(xorOut, {"xor register"}, {});
+        testProto.finalize();
+
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        PipelinedNetlist pipelined{FlatNetlist(heimdall)};
+        assert(pipelined.isPipeline() && pipelined.getNumStages() == 3);
+        auto stimulus = [](int t, int i) { return (bool)((t * 7 + i * 3) % 5 & 1); };
+
+        std::ostringstream expected, shown;
+        auto old = std::cout.rdbuf(expected.rdbuf());
+        for (int t = 0; t < 100; t++) {
+            for (int i = 0; i < 3; i++) heimdall.findInput("in" + std::to_string(i + 1))->setValue(stimulus(t, i));
+            heimdall.tick();
+        }
+        std::cout.rdbuf(shown.rdbuf());
+        pipelined.run(100, [&](int t) {
+            for (int i = 0; i < 3; i++) pipelined.setInput("in" + std::to_string(i + 1), stimulus(t, i));
+        });
+        std::cout.rdbuf(old);
+        assert(expected.str() == shown.str());
+        assert(pipelined.getValue(test->getOutput(0)) == test->getOutput(0)->getValue());
+    }
+    {
+        // the clock and the halvers repeat every 8 ticks, so a billion ticks are a few recorded ones, and the probes show
+        // the same as ticking one after the other
+        auto build = [&](CompositePrototype& testProto, bool probes) {
+            testProto.addPrototype(clkPrototype, {}, {"clk/1"});
+            testProto.addPrototype(halverPrototype, {"clk/1"}, {"clk/2"});
+            testProto.addPrototype(halverPrototype, {"clk/2"}, {"clk/4"});
+            testProto.addPrototype(registerPrototype, {"clk/4"}, {"sampled clk/4"});
+            if (probes) {
+                static OutputPrototype clk1("clk/1"), clk4("clk/4");
+                testProto.addPrototype(clk1, {"clk/1"}, {});
+                testProto.addPrototype(clk4, {"clk/4"}, {});
+            }
+            testProto.finalize();
+        };
+        for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::EventDriven}) {
+            CompositePrototype testProto("test", {}, {"sampled clk/4"});
+            build(testProto, false);
+            GateKeeper fast(engine), slow(engine);
+            fast.setFastForward(true);
+            auto fastTest = testProto.instantiate(&fast), slowTest = testProto.instantiate(&slow);
+            fastTest->link({});
+            slowTest->link({});
+            fast.run(1000000000);
+            for (int i = 0; i < 64 + (1000000000 - 64) % 8; i++) slow.tick();
+            assert(fast.getSimulatedTicks() < 100);
+            assert(fastTest->getOutput(0)->getValue() == slowTest->getOutput(0)->getValue());
+            fast.tick(), slow.tick(); // keeps ticking from the skipped to state
+            assert(fastTest->getOutput(0)->getValue() == slowTest->getOutput(0)->getValue());
+        }
+        CompositePrototype testProto("test", {}, {"sampled clk/4"});
+        build(testProto, true);
+        GateKeeper fast, slow;
+        fast.setFastForward(true);
+        auto fastTest = testProto.instantiate(&fast), slowTest = testProto.instantiate(&slow);
+        fastTest->link({});
+        slowTest->link({});
+        std::ostringstream expected, shown;
+        auto old = std::cout.rdbuf(shown.rdbuf());
+        fast.run(1001);
+        std::cout.rdbuf(expected.rdbuf());
+        slow.run(1001);
+        std::cout.rdbuf(old);
+        assert(expected.str() == shown.str() && fast.getSimulatedTicks() < 100);
+        std::cout << "fast forward: " << fast.getSimulatedTicks() << " of 1001 ticks simulated" << std::endl;
+
+        // the 8 tick period of the probes does not fit 20 bytes, so the run falls back to ticking
+        GateKeeper capped;
+        capped.setFastForward(true, 20);
+        testProto.instantiate(&capped)->link({});
+        std::ostringstream cappedShown;
+        old = std::cout.rdbuf(cappedShown.rdbuf());
+        capped.run(1001);
+        std::cout.rdbuf(old);
+        assert(cappedShown.str() == expected.str() && capped.getSimulatedTicks() == 1001);
+    }
+    {
+        // a probe on a nand HashNands merged into its twin shows the twin's values when fast-forwarded
+        OutputPrototype shownTwin("twin");
+        CompositePrototype testProto("test", {}, {"state"});
+        testProto.addPrototype(nandPrototype, {"state", "state"}, {"next state"});
+        testProto.addPrototype(nandPrototype, {"state", "state"}, {"twin"});
+        testProto.addPrototype(registerPrototype, {"next state"}, {"state"});
+        testProto.addPrototype(shownTwin, {"twin"}, {});
+        testProto.finalize();
+        GateKeeper fast, slow;
+        fast.setOptimizations(GateKeeper::HashNands);
+        fast.setFastForward(true);
+        auto fastTest = testProto.instantiate(&fast), slowTest = testProto.instantiate(&slow);
+        fastTest->link({});
+        slowTest->link({});
+        std::ostringstream expected, shown;
+        auto old = std::cout.rdbuf(shown.rdbuf());
+        fast.run(6);
+        std::cout.rdbuf(expected.rdbuf());
+        for (int t = 0; t < 6; t++) slow.tick();
+        std::cout.rdbuf(old);
+        assert(expected.str() == shown.str() && fast.getSimulatedTicks() < 6);
+    }
+    {
+        // the optimizations leave the probes showing the same with every engine, on an 8+8 bit adder with changing inputs
+        std::vector<OutputPrototype> probes(adder8Outputs.begin(), adder8Outputs.end());
+        CompositePrototype testProto("test", {}, {});
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        for (int k = 0; k < 9; k++)
+            testProto.addPrototype(probes[k], {adder8Outputs[k]}, {});
+        testProto.finalize();
+
+        // only the lowest bit is probed, and a register samples the carry nobody reads
+        OutputPrototype lowestBit("c1");
+        CompositePrototype lowestBitProto("test", {}, {"sampled carry"});
+        addAdder8Inputs(lowestBitProto);
+        lowestBitProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        lowestBitProto.addPrototype(lowestBit, {"c1"}, {});
+        lowestBitProto.addPrototype(registerPrototype, {"carry"}, {"sampled carry"});
+        lowestBitProto.finalize();
+
+        std::map<std::string, int> hashed;
+        auto simulate = [&](GateKeeper::Engine engine, unsigned optimizations, int& simulated,
+                            const CompositePrototype* proto = nullptr, bool observeOutput = false) {
+            GateKeeper heimdall(engine);
+            heimdall.setParallelism(3, 1);
+            heimdall.setOptimizations(optimizations);
+            auto test = (proto ? *proto : testProto).instantiate(&heimdall);
+            test->link({});
+            if (observeOutput) heimdall.observe(test->getOutput(0));
+            std::ostringstream shown;
+            auto old = std::cout.rdbuf(shown.rdbuf());
+            for (int t = 0; t < 50; t++) {
+                for (int i = 0; i < 16; i++) heimdall.findInput(adder8Inputs[i])->setValue((t * 40503 >> i) & 1);
+                heimdall.tick();
+                if (observeOutput) std::cout << "sampled carry: " << test->getOutput(0)->getValue() << std::endl;
+            }
+            std::cout.rdbuf(old);
+            simulated = heimdall.getNumSimulatedNands();
+            hashed = heimdall.getHashedByPrototype();
+            return shown.str();
+        };
+        for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::EventDriven, GateKeeper::Engine::BitParallel,
+                            GateKeeper::Engine::LevelParallel, GateKeeper::Engine::Partitioned, GateKeeper::Engine::WorkStealing}) {
+            int all, optimized;
+            std::string expected = simulate(engine, 0, all);
+            assert(simulate(engine, GateKeeper::FoldConstants, optimized) == expected && optimized < all);
+            if (engine == GateKeeper::Engine::Levelized)
+                std::cout << "constant folding: " << optimized << " of " << all << " nands simulated" << std::endl;
+            assert(simulate(engine, GateKeeper::HashNands, optimized) == expected && optimized < all);
+            assert(simulate(engine, GateKeeper::FoldConstants | GateKeeper::HashNands, optimized) == expected);
+            if (engine == GateKeeper::Engine::Levelized)
+                std::cout << "constant folding and structural hashing: " << optimized << " of " << all << " nands simulated"
+                          << std::endl;
+
+            unsigned everything = GateKeeper::FoldConstants | GateKeeper::HashNands | GateKeeper::RemoveDeadLogic;
+            assert(simulate(engine, everything, optimized) == expected);
+            expected = simulate(engine, 0, all, &lowestBitProto);
+            assert(simulate(engine, GateKeeper::RemoveDeadLogic, optimized, &lowestBitProto) == expected);
+            if (engine == GateKeeper::Engine::Levelized)
+                std::cout << "dead logic elimination, probing the lowest bit: " << optimized << " of " << all
+                          << " nands simulated" << std::endl;
+            assert(optimized < all / 10);
+            expected = simulate(engine, 0, all, &lowestBitProto, true);
+            assert(simulate(engine, everything, optimized, &lowestBitProto, true) == expected && optimized < 139);
+        }
+        for (auto& h : hashed) std::cout << "structural hashing removed " << h.second << " nands from " << h.first << std::endl;
+    }
+    {
+        // registers reading folded nands get their constant values with the Partitioned engine
+        InputPrototype in("in");
+        CompositePrototype testProto("test", {}, {"sampled high", "sampled in"});
+        testProto.addPrototype(in, {}, {"in"});
+        testProto.addPrototype(lowPrototype, {}, {"low"});
+        testProto.addPrototype(notPrototype, {"low"}, {"high"});
+        testProto.addPrototype(registerPrototype, {"high"}, {"sampled high"});
+        testProto.addPrototype(registerPrototype, {"in"}, {"sampled in"});
+        testProto.finalize();
+        GateKeeper heimdall(GateKeeper::Engine::Partitioned);
+        heimdall.setOptimizations(GateKeeper::FoldConstants);
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        for (int t = 0; t < 4; t++) {
+            heimdall.findInput("in")->setValue(t & 1);
+            heimdall.tick();
+            assert(test->getOutput(0)->getValue() && test->getOutput(1)->getValue() == (bool)(t & 1));
+        }
+        assert(heimdall.getNumFoldedNands() == 1);
+    }
+    {
+        // an xor is a single cell, and the 8+8 bit adder mapped onto cells adds the same as the nands
+        InputPrototype in1("in1"), in2("in2");
+        CompositePrototype xorProto("test", {}, {"sampled xor"});
+        xorProto.addPrototype(in1, {}, {"1"});
+        xorProto.addPrototype(in2, {}, {"2"});
+        xorProto.addPrototype(xorPrototype, {"1", "2"}, {"xor"});
+        xorProto.addPrototype(registerPrototype, {"xor"}, {"sampled xor"});
+        xorProto.finalize();
+        GateKeeper xorKeeper;
+        auto xorTest = xorProto.instantiate(&xorKeeper);
+        xorTest->link({});
+        LutNetlist xorCells{FlatNetlist(xorKeeper)};
+        assert(xorCells.getNumCells() == 1);
+        for (int v = 0; v < 4; v++) {
+            xorCells.setInput("in1", v & 1);
+            xorCells.setInput("in2", v >> 1);
+            xorCells.tick();
+            assert(xorCells.getValue(xorTest->getOutput(0)) == ((v & 1) != (v >> 1)));
+        }
+
+        CompositePrototype testProto("test", {}, adder8Outputs);
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        std::vector<std::string> sampled;
+        for (auto& sum : adder8Outputs) {
+            sampled.push_back("sampled " + sum);
+            testProto.addPrototype(registerPrototype, {sum}, {sampled.back()});
+        }
+        testProto.finalize();
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        FlatNetlist flat(heimdall);
+        LutNetlist cells(flat);
+        for (int v = 0; v < (1 << 16); v++) {
+            for (int i = 0; i < 16; i++) {
+                flat.setInput(adder8Inputs[i], adder8Input(v, i));
+                cells.setInput(adder8Inputs[i], adder8Input(v, i));
+            }
+            flat.tick();
+            cells.tick();
+            for (int k = 0; k < 9; k++) assert(cells.getValue(test->getOutput(k)) == flat.getValue(test->getOutput(k)));
+        }
+
+        const int benchTicks = 200000;
+        double nands = (double)heimdall.getNumGates() - 16 - 9 - 1; // without the inputs, the registers and the low
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < benchTicks; t++) flat.tick();
+        std::chrono::duration<double> flatTime = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < benchTicks; t++) cells.tick();
+        std::chrono::duration<double> cellTime = std::chrono::steady_clock::now() - start;
+        std::cout << "8+8 bit adder as " << cells.getNumCells() << " cells: " << nands * benchTicks / flatTime.count()
+                  << " nands/s as nands, " << nands * benchTicks / cellTime.count() << " nands/s as cells" << std::endl;
+    }
+    for (int width : {64, 256, 512}) {
+        // exhaustive check of the 8+8 bit adder, width additions per tick
+        GateKeeper heimdall(GateKeeper::Engine::BitParallel, width);
+        CompositePrototype testProto("test", {}, adder8Outputs);
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        testProto.finalize();
+
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        const int words = width / 64;
+        for (int first = 0; first < (1 << 16); first += width) {
+            for (int i = 0; i < 16; i++)
+                for (int w = 0; w < words; w++) heimdall.findInput(adder8Inputs[i])->setLanes(adder8InputLanes(first + w * 64, i), w);
+            heimdall.tick();
+            for (int lane = 0; lane < width; lane++)
+                for (int k = 0; k < 9; k++)
+                    assert((bool)((heimdall.getLanes(test->getOutput(k), lane / 64) >> lane % 64) & 1) == adder8Output(first + lane, k));
+        }
+
+        // benchmark: the inputs are left as they are, only the netlist sweep is measured
+        const int benchTicks = 20000;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < benchTicks; t++)
+            heimdall.tick();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "8+8 bit adder, " << width << " lanes (" << heimdall.getKernelName() << "): "
+                  << (double)benchTicks * width / elapsed.count() << " vectors/s" << std::endl;
+    }
+    {
+        // the words of the lanes are independent, whatever order they are set in
+        InputPrototype in("in");
+        CompositePrototype testProto("test", {}, {"sampled"});
+        testProto.addPrototype(in, {}, {"in"});
+        testProto.addPrototype(registerPrototype, {"in"}, {"sampled"});
+        testProto.finalize();
+        GateKeeper heimdall(GateKeeper::Engine::BitParallel, 256);
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        Input* input = heimdall.findInput("in");
+        const uint64_t words[] = {1, 0x1234, 0xfedcba9876543210ull, 0};
+        for (int w : {1, 3, 0, 2}) input->setLanes(words[w], w);
+        heimdall.tick();
+        heimdall.tick();
+        for (int w = 0; w < 4; w++) assert(heimdall.getLanes(test->getOutput(0), w) == words[w]);
+        assert(input->getValue());
+    }
+    {
+        // tabulated prototypes: the 3-bit adder as two truth tables, the 8+8 bit adder as nine
+        CompositePrototype adderTable("3-bit adder table", {"1", "2", "3"}, {"value", "carry"});
+        adderTable.addPrototype(adderPrototype, {"1", "2", "3"}, {"value", "carry"});
+        adderTable.finalize(true);
+        CompositePrototype adder8OfTables("8+8 bit adder of tables", adder8Inputs, adder8Outputs);
+        adder8OfTables.addPrototype(lowPrototype, {}, {"carry0"});
+        for (int i = 1; i <= 8; i++) {
+            std::string n = std::to_string(i), carry = i == 8 ? "carry" : "carry" + n;
+            adder8OfTables.addPrototype(adderTable, {"a" + n, "b" + n, "carry" + std::to_string(i - 1)}, {"c" + n, carry});
+        }
+        adder8OfTables.finalize();
+        CompositePrototype adder8Table("8+8 bit adder table", adder8Inputs, adder8Outputs);
+        adder8Table.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        adder8Table.finalize(true);
+        CompositePrototype withRegister("sampled not", {"in"}, {"out"});
+        withRegister.addPrototype(notPrototype, {"in"}, {"not"});
+        withRegister.addPrototype(registerPrototype, {"not"}, {"out"});
+        withRegister.finalize(true);
+        assert(adderTable.isTabulated() && adder8Table.isTabulated() && !adder8OfTables.isTabulated());
+        assert(!withRegister.isTabulable() && !withRegister.isTabulated());
+
+        for (const CompositePrototype* adder : {&adder8OfTables, &adder8Table}) {
+            for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy}) {
+                for (unsigned flags : {0u, (unsigned)(GateKeeper::FoldConstants | GateKeeper::HashNands | GateKeeper::RemoveDeadLogic)}) {
+                    std::vector<std::string> sampled;
+                    for (auto& sum : adder8Outputs) sampled.push_back("sampled " + sum);
+                    CompositePrototype testProto("test", {}, sampled);
+                    addAdder8Inputs(testProto);
+                    testProto.addPrototype(*adder, adder8Inputs, adder8Outputs);
+                    std::vector<OutputPrototype> probes;
+                    probes.reserve(adder8Outputs.size());
+                    for (int k = 0; k < 9; k++) {
+                        testProto.addPrototype(registerPrototype, {adder8Outputs[k]}, {sampled[k]});
+                        probes.emplace_back(adder8Outputs[k]);
+                        testProto.addPrototype(probes.back(), {sampled[k]}, {});
+                    }
+                    testProto.finalize();
+                    GateKeeper heimdall(engine);
+                    heimdall.setOptimizations(flags);
+                    auto test = testProto.instantiate(&heimdall);
+                    test->link({});
+                    assert(heimdall.getNumGates() == 16 + (adder == &adder8Table ? 9 : 1 + 8 * 2) + 9 * 2);
+                    std::stringstream shown;
+                    auto old = std::cout.rdbuf(shown.rdbuf());
+                    for (int v = 0; v < (1 << 16); v += 97) {
+                        setAdder8Inputs(heimdall, v);
+                        heimdall.tick();
+                        for (int k = 0; k < 9; k++) assert(test->getOutput(k)->getValue() == adder8Output(v, k));
+                    }
+                    std::cout.rdbuf(old);
+                }
+            }
+        }
+
+        // the engines and the netlists which cannot run tables refuse them
+        CompositePrototype testProto("test", {}, {});
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Table, adder8Inputs, adder8Outputs);
+        testProto.finalize();
+        GateKeeper levelized, eventDriven(GateKeeper::Engine::EventDriven);
+        testProto.instantiate(&levelized)->link({});
+        testProto.instantiate(&eventDriven)->link({});
+        bool refused = false;
+        try {
+            eventDriven.tick();
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        assert(refused);
+        refused = false;
+        try {
+            FlatNetlist flat(levelized);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        assert(refused);
+    }
+    for (unsigned flags : {0u, (unsigned)GateKeeper::RemoveDeadLogic}) {
+        // RemoveDeadLogic keeps the logic feeding the flip-flops, as they are ticked whether a probe reads them or not
+        InputPrototype data("data"), enable("enable");
+        OutputPrototype shownD("d"), shownSR("sr");
+        CompositePrototype testProto("test", {}, {"d", "sr"});
+        testProto.addPrototype(data, {}, {"data"});
+        testProto.addPrototype(enable, {}, {"enable"});
+        testProto.addPrototype(lowPrototype, {}, {"low"});
+        testProto.addPrototype(notPrototype, {"data"}, {"not data"});
+        testProto.addPrototype(xorPrototype, {"data", "enable"}, {"toggle"});
+        testProto.addPrototype(*GatePrototype<DFlipFlop>::getInstance(), {"not data", "enable", "low"}, {"d"});
+        testProto.addPrototype(*GatePrototype<SRFlipFlop>::getInstance(), {"toggle", "not data", "enable"}, {"sr"});
+        testProto.addPrototype(shownD, {"d"}, {});
+        testProto.addPrototype(shownSR, {"sr"}, {});
+        testProto.finalize();
+        GateKeeper heimdall;
+        heimdall.setOptimizations(flags);
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        std::stringstream shown;
+        auto old = std::cout.rdbuf(shown.rdbuf());
+        bool d = false, sr = false;
+        uint32_t seed = 3141592653u;
+        for (int t = 0; t < 200; t++) {
+            seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+            bool dataValue = seed & 1, enableValue = seed & 2;
+            heimdall.findInput("data")->setValue(dataValue);
+            heimdall.findInput("enable")->setValue(enableValue);
+            heimdall.tick();
+            d = enableValue ? !dataValue : d;
+            sr = enableValue ? dataValue && ((dataValue != enableValue) || sr) : sr;
+            assert(test->getOutput(0)->getValue() == d && test->getOutput(1)->getValue() == sr);
+        }
+        std::cout.rdbuf(old);
+    }
+    {
+        // the native cells against their functions, the outputs packed lowest first
+        struct Case { const IPrototype* proto; std::function<uint32_t(uint32_t)> expected; };
+        std::vector<Case> cases = {
+            {GatePrototype<AndCell<3>>::getInstance(), [](uint32_t c) { return (uint32_t)(c == 7); }},
+            {GatePrototype<OrCell<3>>::getInstance(), [](uint32_t c) { return (uint32_t)(c != 0); }},
+            {GatePrototype<NandCell<3>>::getInstance(), [](uint32_t c) { return (uint32_t)(c != 7); }},
+            {GatePrototype<NorCell<3>>::getInstance(), [](uint32_t c) { return (uint32_t)(c == 0); }},
+            {GatePrototype<XorCell<3>>::getInstance(), [](uint32_t c) { return (c ^ c >> 1 ^ c >> 2) & 1; }},
+            {GatePrototype<XnorCell<2>>::getInstance(), [](uint32_t c) { return (uint32_t)((c & 1) == (c >> 1)); }},
+            {GatePrototype<NotCell>::getInstance(), [](uint32_t c) { return c ^ 1; }},
+            {GatePrototype<MuxCell>::getInstance(), [](uint32_t c) { return c & 1 ? c >> 2 : c >> 1 & 1; }},
+            {GatePrototype<FullAdderCell>::getInstance(), [](uint32_t c) { // sum, carry
+                int sum = (c & 1) + (c >> 1 & 1) + (c >> 2);
+                return (uint32_t)((sum & 1) | (sum >> 1) << 1);
+            }},
+        };
+        for (auto& cs : cases) {
+            for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy}) {
+                int in = cs.proto->getNumInputs(), out = cs.proto->getNumOutputs();
+                std::vector<std::string> names, cellOutputs, sampled;
+                for (int i = 0; i < in; i++) names.push_back("in" + std::to_string(i));
+                for (int k = 0; k < out; k++) cellOutputs.push_back("out" + std::to_string(k));
+                for (int k = 0; k < out; k++) sampled.push_back("sampled out" + std::to_string(k));
+                std::vector<InputPrototype> inputs(names.begin(), names.end());
+                CompositePrototype testProto("test", {}, sampled);
+                for (int i = 0; i < in; i++)
+                    testProto.addPrototype(inputs[i], {}, {names[i]});
+                testProto.addPrototype(*cs.proto, names, cellOutputs);
+                for (int k = 0; k < out; k++)
+                    testProto.addPrototype(registerPrototype, {cellOutputs[k]}, {sampled[k]});
+                testProto.finalize();
+                GateKeeper heimdall(engine);
+                auto test = testProto.instantiate(&heimdall);
+                test->link({});
+                for (uint32_t c = 0; c < (1u << in); c++) {
+                    for (int i = 0; i < in; i++) heimdall.findInput(names[i])->setValue(c >> i & 1);
+                    heimdall.tick();
+                    for (int k = 0; k < out; k++) assert(test->getOutput(k)->getValue() == (bool)(cs.expected(c) >> k & 1));
+                }
+            }
+        }
+    }
+    {
+        // the 8+8 bit adder of full adder cells, against the sum, and its evaluations against the nands of adder8Prototype
+        CompositePrototype nativeAdder8("native 8+8 bit adder", adder8Inputs, adder8Outputs);
+        nativeAdder8.addPrototype(lowPrototype, {}, {"carry0"});
+        for (int i = 1; i <= 8; i++) {
+            std::string n = std::to_string(i), carry = i == 8 ? "carry" : "carry" + n;
+            nativeAdder8.addPrototype(*GatePrototype<FullAdderCell>::getInstance(), {"a" + n, "b" + n, "carry" + std::to_string(i - 1)},
+                                      {"c" + n, carry});
+        }
+        nativeAdder8.finalize();
+        int evaluations[2];
+        for (int native = 0; native < 2; native++) {
+            std::vector<std::string> sampled;
+            for (auto& sum : adder8Outputs) sampled.push_back("sampled " + sum);
+            CompositePrototype testProto("test", {}, sampled);
+            addAdder8Inputs(testProto);
+            testProto.addPrototype(native ? nativeAdder8 : adder8Prototype, adder8Inputs, adder8Outputs);
+            for (int k = 0; k < 9; k++)
+                testProto.addPrototype(registerPrototype, {adder8Outputs[k]}, {sampled[k]});
+            testProto.finalize();
+            GateKeeper heimdall;
+            auto test = testProto.instantiate(&heimdall);
+            test->link({});
+            evaluations[native] = heimdall.getNumGates() - 16 - 9 - 1; // without the inputs, the registers and the low
+            for (int v = 0; v < (1 << 16); v += 13) {
+                setAdder8Inputs(heimdall, v);
+                heimdall.tick();
+                for (int k = 0; k < 9; k++) assert(test->getOutput(k)->getValue() == adder8Output(v, k));
+            }
+        }
+        assert(evaluations[1] * 5 <= evaluations[0]);
+        std::cout << "8+8 bit adder: " << evaluations[0] << " nands, " << evaluations[1] << " full adder cells" << std::endl;
+    }
+    for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy, GateKeeper::Engine::EventDriven,
+                        GateKeeper::Engine::LevelParallel, GateKeeper::Engine::WorkStealing}) {
+        // the native flip-flops against their definitions, on random inputs
+        std::vector<std::string> names = {"data", "enable", "reset", "set"};
+        std::vector<InputPrototype> inputs(names.begin(), names.end());
+        CompositePrototype testProto("test", {}, {"d", "sr"});
+        for (int i = 0; i < 4; i++)
+            testProto.addPrototype(inputs[i], {}, {names[i]});
+        testProto.addPrototype(*GatePrototype<DFlipFlop>::getInstance(), {"data", "enable", "reset"}, {"d"});
+        testProto.addPrototype(*GatePrototype<SRFlipFlop>::getInstance(), {"set", "reset", "enable"}, {"sr"});
+        testProto.finalize();
+        GateKeeper heimdall(engine);
+        heimdall.setParallelism(4, 1);
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        bool d = false, sr = false;
+        uint32_t seed = 2463534242u;
+        for (int t = 0; t < 1000; t++) {
+            seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+            bool data = seed & 1, enable = seed & 2, reset = (seed & 12) == 12, set = seed & 16;
+            heimdall.findInput("data")->setValue(data);
+            heimdall.findInput("enable")->setValue(enable);
+            heimdall.findInput("reset")->setValue(reset);
+            heimdall.findInput("set")->setValue(set);
+            heimdall.tick();
+            d = !reset && (enable ? data : d);
+            sr = enable ? !reset && (set || sr) : sr;
+            assert(test->getOutput(0)->getValue() == d && test->getOutput(1)->getValue() == sr);
+        }
+    }
+    {
+        // word-level primitives: the 8+8 bit adder as a 9-bit add between a concat and a split, and an alu
+        WordPrototype concat9(WordOp::Concat, 9), concat8(WordOp::Concat, 8), add9(WordOp::Add, 9);
+        SplitPrototype split9(9);
+        CompositePrototype wordAdder8("word 8+8 bit adder", adder8Inputs, adder8Outputs);
+        wordAdder8.addPrototype(lowPrototype, {}, {"low"});
+        wordAdder8.addPrototype(concat9, {"a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8", "low"}, {"a"});
+        wordAdder8.addPrototype(concat9, {"b1", "b2", "b3", "b4", "b5", "b6", "b7", "b8", "low"}, {"b"});
+        wordAdder8.addPrototype(add9, {"a", "b"}, {"sum"});
+        wordAdder8.addPrototype(split9, {"sum"}, {"c1", "c2", "c3", "c4", "c5", "c6", "c7", "c8", "carry"});
+        wordAdder8.finalize();
+
+        std::vector<std::string> sampled;
+        for (auto& sum : adder8Outputs) sampled.push_back("sampled " + sum);
+        for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy}) {
+            for (unsigned flags : {0u, (unsigned)(GateKeeper::FoldConstants | GateKeeper::HashNands | GateKeeper::RemoveDeadLogic)}) {
+                CompositePrototype testProto("test", {}, sampled);
+                addAdder8Inputs(testProto);
+                testProto.addPrototype(wordAdder8, adder8Inputs, adder8Outputs);
+                std::vector<OutputPrototype> probes(adder8Outputs.begin(), adder8Outputs.end());
+                for (int k = 0; k < 9; k++) {
+                    testProto.addPrototype(registerPrototype, {adder8Outputs[k]}, {sampled[k]});
+                    testProto.addPrototype(probes[k], {sampled[k]}, {});
+                }
+                testProto.finalize();
+                GateKeeper heimdall(engine);
+                heimdall.setOptimizations(flags);
+                auto test = testProto.instantiate(&heimdall);
+                test->link({});
+                std::stringstream shown;
+                auto old = std::cout.rdbuf(shown.rdbuf());
+                for (int v = 0; v < (1 << 16); v += 7) {
+                    setAdder8Inputs(heimdall, v);
+                    heimdall.tick();
+                    for (int k = 0; k < 9; k++) assert(test->getOutput(k)->getValue() == adder8Output(v, k));
+                }
+                std::cout.rdbuf(old);
+            }
+
+            std::vector<std::string> results = {"add", "sub", "and", "or", "xor", "not", "shift left", "shift right", "equal",
+                                                "less", "mux"};
+            std::vector<WordPrototype> ops;
+            for (int op = WordOp::Add; op <= WordOp::Mux; op++) ops.emplace_back((WordOp::Op)op, 8);
+            WordPrototype add16(WordOp::Add, 16);
+            WordRegisterPrototype register8(8), register16(16);
+            std::vector<std::string> outputs;
+            for (auto& r : results) outputs.push_back("sampled " + r);
+            outputs.push_back("acc");
+            CompositePrototype alu("alu", {}, outputs);
+            addAdder8Inputs(alu);
+            alu.addPrototype(concat8, {"a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8"}, {"x"});
+            alu.addPrototype(concat8, {"b1", "b2", "b3", "b4", "b5", "b6", "b7", "b8"}, {"y"});
+            for (int op = 0; op < (int)ops.size(); op++) {
+                std::vector<std::string> operands = {"x", "y"};
+                if (op == WordOp::Not) operands = {"x"};
+                if (op == WordOp::Mux) operands = {"a1", "x", "y"};
+                alu.addPrototype(ops[op], operands, {results[op]});
+                alu.addPrototype(register8, {results[op]}, {outputs[op]});
+            }
+            alu.addPrototype(add16, {"acc", "x"}, {"acc + x"});
+            alu.addPrototype(register16, {"acc + x"}, {"acc"});
+            alu.finalize();
+            GateKeeper heimdall(engine);
+            auto test = alu.instantiate(&heimdall);
+            test->link({});
+            auto word = [&test](int k) { return static_cast<WordGate*>(test->getOutput(k))->getWord(); };
+            uint64_t acc = 0;
+            for (int v = 0; v < (1 << 16); v += 257) {
+                setAdder8Inputs(heimdall, v);
+                heimdall.tick();
+                uint64_t x = v & 0xff, y = v >> 8;
+                acc = (acc + x) & 0xffff;
+                uint64_t expected[] = {(x + y) & 0xff, (x - y) & 0xff, x & y, x | y, x ^ y, ~x & 0xff, y >= 8 ? 0 : x << y & 0xff,
+                                       y >= 8 ? 0 : x >> y, x == y, x < y, x & 1 ? y : x, acc};
+                for (int k = 0; k < (int)outputs.size(); k++) assert(word(k) == expected[k]);
+            }
+        }
+    }
+    {
+        // a 64 KiB ROM mapped from a file, and a 256 byte RAM, written and read back one tick later
+        char romPath[] = "/tmp/circuit-simulator-rom-XXXXXX";
+        int romFd = mkstemp(romPath); // created by this run only, so neither shared with a concurrent run nor a planted link
+        assert(romFd >= 0);
+        const std::string romFile = romPath;
+        struct RemovedAtExit {
+            const std::string& file;
+            ~RemovedAtExit() { std::remove(file.c_str()); }
+        } removed{romFile};
+        {
+            std::vector<char> contents(1 << 16);
+            for (int a = 0; a < (1 << 16); a++) contents[a] = (char)(a * 7 ^ a >> 8);
+            bool written = write(romFd, contents.data(), contents.size()) == (ssize_t)contents.size();
+            close(romFd);
+            assert(written);
+        }
+        std::vector<std::string> names;
+        for (int i = 0; i < 16; i++) names.push_back("in" + std::to_string(i));
+        names.push_back("write");
+        std::vector<InputPrototype> inputs(names.begin(), names.end());
+        std::vector<std::string> low8(names.begin(), names.begin() + 8), high8(names.begin() + 8, names.begin() + 16);
+        WordPrototype concat16(WordOp::Concat, 16), concat8(WordOp::Concat, 8);
+        MemoryPrototype rom(1 << 16, 8, true, romFile), ram(256, 8), ramFromFile(256, 8, false, romFile);
+        for (auto engine : {GateKeeper::Engine::Levelized, GateKeeper::Engine::Lazy}) {
+            CompositePrototype testProto("test", {}, {"rom", "ram", "ram from file"});
+            for (int i = 0; i < 17; i++)
+                testProto.addPrototype(inputs[i], {}, {names[i]});
+            testProto.addPrototype(concat16, std::vector<std::string>(names.begin(), names.begin() + 16), {"address16"});
+            testProto.addPrototype(concat8, low8, {"address"});
+            testProto.addPrototype(concat8, high8, {"data"});
+            testProto.addPrototype(rom, {"address16"}, {"rom"});
+            testProto.addPrototype(ram, {"address", "data", "write"}, {"ram"});
+            testProto.addPrototype(ramFromFile, {"address", "data", "write"}, {"ram from file"});
+            testProto.finalize();
+            GateKeeper heimdall(engine);
+            auto test = testProto.instantiate(&heimdall);
+            test->link({});
+            assert(heimdall.getNumGates() == 17 + 3 + 3);
+            auto word = [&test](int k) { return static_cast<WordGate*>(test->getOutput(k))->getWord(); };
+            auto set = [&heimdall, &names](int v, bool write) {
+                for (int i = 0; i < 16; i++) heimdall.findInput(names[i])->setValue(v >> i & 1);
+                heimdall.findInput("write")->setValue(write);
+            };
+            for (int a = 0; a < (1 << 16); a += 31) {
+                set(a, false);
+                heimdall.tick();
+                assert(word(0) == (uint64_t)(uint8_t)(a * 7 ^ a >> 8));
+                assert(word(2) == (uint64_t)(uint8_t)((a & 0xff) * 7));
+            }
+            for (int a = 0; a < 256; a++) { // the read gets the word from before the write
+                set(a | (255 - a) << 8, true);
+                heimdall.tick();
+                assert(word(1) == 0 && word(2) == (uint64_t)(uint8_t)(a * 7));
+            }
+            for (int a = 0; a < 256; a++) {
+                set(a, false);
+                heimdall.tick();
+                assert(word(1) == (uint64_t)(255 - a) && word(2) == (uint64_t)(255 - a));
+            }
+        }
+        std::ifstream in(romFile, std::ios::binary);
+        for (int a = 0; a < 256; a++) assert(in.get() == (uint8_t)(a * 7)); // the writes stayed in the private mapping
+    }
+    {
+        // 200 instances of the 8+8 bit adder in one batch, each adding its own vectors
+        std::vector<OutputPrototype> probes(adder8Outputs.begin(), adder8Outputs.end());
+        std::vector<std::string> sampled;
+        for (auto& sum : adder8Outputs) sampled.push_back("sampled " + sum);
+        CompositePrototype testProto("test", {}, sampled);
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        for (int k = 0; k < 9; k++) {
+            testProto.addPrototype(registerPrototype, {adder8Outputs[k]}, {sampled[k]});
+            testProto.addPrototype(probes[k], {adder8Outputs[k]}, {});
+        }
+        testProto.finalize();
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        const int instances = 200;
+        BatchNetlist batch(FlatNetlist(heimdall), instances);
+        std::vector<int> inputIndex;
+        for (auto& name : adder8Inputs) inputIndex.push_back(batch.findInput(name));
+        for (int t = 0; t < 20; t++) {
+            for (int instance = 0; instance < instances; instance++) {
+                int v = (instance * 331 + t * 977) & 0xffff;
+                for (int i = 0; i < 16; i++) batch.setInput(inputIndex[i], instance, adder8Input(v, i));
+            }
+            batch.tick();
+            for (int instance = 0; instance < instances; instance++) {
+                int v = (instance * 331 + t * 977) & 0xffff;
+                for (int k = 0; k < 9; k++) {
+                    bool expected = adder8Output(v, k);
+                    assert(batch.getValue(test->getOutput(k), instance) == expected);
+                    assert(batch.getProbeName(k) == adder8Outputs[k] && batch.getProbeValue(k, instance) == expected);
+                }
+            }
+        }
+        std::cout << "batch of " << instances << " 8+8 bit adders: " << (double)batch.getMemoryUsage() / instances
+                  << " bytes per instance" << std::endl;
+    }
+    {
+        // the registers of the instances are independent: a toggle flip-flop by instance, fed with its own bits
+        InputPrototype toggle("toggle");
+        CompositePrototype testProto("test", {}, {"parity"});
+        testProto.addPrototype(toggle, {}, {"toggle"});
+        testProto.addPrototype(xorPrototype, {"toggle", "parity"}, {"next parity"});
+        testProto.addPrototype(registerPrototype, {"next parity"}, {"parity"});
+        testProto.finalize();
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        const int instances = 150;
+        BatchNetlist batch(FlatNetlist(heimdall), instances);
+        std::vector<bool> parity(instances, false);
+        uint32_t seed = 88172645u;
+        for (int t = 0; t < 100; t++) {
+            for (int instance = 0; instance < instances; instance++) {
+                seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+                batch.setInput("toggle", instance, seed & 1);
+                parity[instance] = parity[instance] != (bool)(seed & 1);
+            }
+            batch.tick();
+            for (int instance = 0; instance < instances; instance++)
+                assert(batch.getValue(test->getOutput(0), instance) == parity[instance]);
+        }
+    }
+    {
+        // the stuck-at faults of a nand: a and b stuck at 0 are the output stuck at 1
+        InputPrototype a("a"), b("b");
+        OutputPrototype out("out");
+        CompositePrototype testProto("test", {}, {"nand"});
+        testProto.addPrototype(a, {}, {"a"});
+        testProto.addPrototype(b, {}, {"b"});
+        testProto.addPrototype(nandPrototype, {"a", "b"}, {"nand"});
+        testProto.addPrototype(out, {"nand"}, {});
+        testProto.finalize();
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        FaultSimulator faults(heimdall);
+        assert(faults.getNumFaults() == 6 && faults.getNumCollapsedFaults() == 4);
+        assert(faults.run({"a", "b"}, {{true, true}}) == 1 && faults.getNumDetected() == 3);
+        assert(faults.run({"a", "b"}, {{true, true}, {false, true}}) == 2 && faults.getNumDetected() == 5);
+        const IGate* nand = test->getOutput(0);
+        assert(faults.getDetectingVector(faults.getFault(nand, false)) == 1); // dropped, so not detected again by {1, 1}
+        assert(faults.getDetectingVector(faults.getFault(nand->getInput(0), false)) == 0);
+        assert(!faults.isDetected(faults.getFault(nand->getInput(1), true)));
+        assert(faults.run({"a", "b"}, {{true, false}}) == 1 && faults.getNumDetected() == 6);
+    }
+    {
+        // fault coverage of the 8+8 bit adder by hierarchy level, with and without collapsing
+        std::vector<OutputPrototype> probes(adder8Outputs.begin(), adder8Outputs.end());
+        CompositePrototype testProto("test", {}, {});
+        addAdder8Inputs(testProto);
+        testProto.addPrototype(adder8Prototype, adder8Inputs, adder8Outputs);
+        for (int k = 0; k < 9; k++)
+            testProto.addPrototype(probes[k], {adder8Outputs[k]}, {});
+        testProto.finalize();
+        GateKeeper heimdall;
+        auto test = testProto.instantiate(&heimdall);
+        test->link({});
+        std::vector<std::vector<bool>> vectors;
+        uint32_t seed = 1234567u;
+        for (int v = 0; v < 64; v++) {
+            seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+            std::vector<bool> vector;
+            for (int i = 0; i < 16; i++) vector.push_back(seed >> i & 1);
+            vectors.push_back(vector);
+        }
+        FaultSimulator collapsed(heimdall), uncollapsed(heimdall, false);
+        collapsed.run(adder8Inputs, vectors);
+        uncollapsed.run(adder8Inputs, vectors);
+        assert(collapsed.getNumCollapsedFaults() < uncollapsed.getNumCollapsedFaults());
+        assert(collapsed.getCoverageByLevel() == uncollapsed.getCoverageByLevel());
+        auto coverage = collapsed.getCoverageByLevel();
+        auto& adders = coverage["[test] [8+8 bit adder] [3-bit adder] "];
+        std::cout << "8+8 bit adder: " << collapsed.getNumFaults() << " faults, " << collapsed.getNumCollapsedFaults()
+                  << " after collapsing, " << collapsed.getNumDetected() << " detected by " << vectors.size()
+                  << " vectors, " << adders.first << " of " << adders.second << " in the 3-bit adders" << std::endl;
+        assert(adders.second > 0 && collapsed.getNumDetected() > collapsed.getNumFaults() * 9 / 10);
+    }
 }